@@ -51,6 +51,12 @@ mad_bit_trunc (bit_t b, int n)
   return b & ((2u << n) - 1);
 }
 
+static inline bit_t __attribute__((const))
+mad_bit_lcut (bit_t b, int n)
+{
+  return b & ~((1u << n) - 1);
+}
+
 int mad_bit_lowest  (bit_t b) __attribute__((const));
 int mad_bit_highest (bit_t b) __attribute__((const));
 
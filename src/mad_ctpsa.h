@@ -47,6 +47,8 @@ typedef struct ctpsa ctpsa_t;
 extern const ord_t mad_tpsa_default;
 extern const ord_t mad_tpsa_same;
 extern       int   mad_tpsa_strict;
+extern       int   mad_tpsa_sparse;  // sparse mul if nnz*sparse < n, 0 = off
+extern       int   mad_tpsa_newton;  // newton minv if no knobs, 0 = fixed point
 
 // --- interface -------------------------------------------------------------o
 
@@ -62,6 +64,7 @@ ord_t    mad_ctpsa_ordv    (const ctpsa_t *t1, const ctpsa_t *t2, ...);  // max
 
 // initialization
 void     mad_ctpsa_copy    (const ctpsa_t *t, ctpsa_t *dst);
+void     mad_ctpsa_copy_ord(const ctpsa_t *t, ctpsa_t *dst, ord_t lo, ord_t hi); // orders [lo,hi] only
 void     mad_ctpsa_clear   (      ctpsa_t *t);
 void     mad_ctpsa_scalar  (      ctpsa_t *t, cnum_t v);
 void     mad_ctpsa_scalar_r(      ctpsa_t *t, num_t v_re, num_t v_im); // without complex-by-value
@@ -107,9 +110,11 @@ void     mad_ctpsa_mder    (const ctpsa_t *a, ctpsa_t *c, int n, const ord_t m[]
 void     mad_ctpsa_add     (const ctpsa_t *a, const ctpsa_t *b, ctpsa_t *c);
 void     mad_ctpsa_sub     (const ctpsa_t *a, const ctpsa_t *b, ctpsa_t *c);
 void     mad_ctpsa_mul     (const ctpsa_t *a, const ctpsa_t *b, ctpsa_t *c);
+void     mad_ctpsa_mul_ord (const ctpsa_t *a, const ctpsa_t *b, ctpsa_t *c, ord_t lo, ord_t hi); // orders [lo,hi] only
 void     mad_ctpsa_div     (const ctpsa_t *a, const ctpsa_t *b, ctpsa_t *c);
 
 void     mad_ctpsa_acc     (const ctpsa_t *a, cnum_t v, ctpsa_t *c);  // c += v*a, aliasing OK
+void     mad_ctpsa_mulacc  (const ctpsa_t *a, const ctpsa_t *b, cnum_t v, ctpsa_t *c); // c += v*a*b
 void     mad_ctpsa_scl     (const ctpsa_t *a, cnum_t v, ctpsa_t *c);  // c  = v*a
 void     mad_ctpsa_inv     (const ctpsa_t *a, cnum_t v, ctpsa_t *c);  // c  = v/a
 void     mad_ctpsa_invsqrt (const ctpsa_t *a, cnum_t v, ctpsa_t *c);  // c  = v/sqrt(a)
@@ -147,6 +152,7 @@ void     mad_ctpsa_nrm1_r   (const ctpsa_t *a, const ctpsa_t *b_, cnum_t *r);
 void     mad_ctpsa_nrm2_r   (const ctpsa_t *a, const ctpsa_t *b_, cnum_t *r);
 void     mad_ctpsa_acc_r    (const ctpsa_t *a, num_t v_re, num_t v_im, ctpsa_t *c);
 void     mad_ctpsa_scl_r    (const ctpsa_t *a, num_t v_re, num_t v_im, ctpsa_t *c);
+void     mad_ctpsa_mulacc_r (const ctpsa_t *a, const ctpsa_t *b, num_t v_re, num_t v_im, ctpsa_t *c);
 void     mad_ctpsa_inv_r    (const ctpsa_t *a, num_t v_re, num_t v_im, ctpsa_t *c);
 void     mad_ctpsa_invsqrt_r(const ctpsa_t *a, num_t v_re, num_t v_im, ctpsa_t *c);
 
@@ -188,9 +194,13 @@ void     mad_ctpsa_ax2pby2pcz2_r(num_t a_re, num_t a_im, const ctpsa_t *x,
 
 // to check for non-homogeneous maps & knobs
 void     mad_ctpsa_poisson (const ctpsa_t *a, const ctpsa_t *b, ctpsa_t *c, int n);  // TO CHECK n
+void     mad_ctpsa_poisson_ord(const ctpsa_t *a, const ctpsa_t *b, ctpsa_t *c, int n, ord_t lo, ord_t hi);
 void     mad_ctpsa_compose (int sa, const ctpsa_t *ma[], int sb, const ctpsa_t *mb[], int sc, ctpsa_t *mc[]);
+void     mad_ctpsa_compose_ord(int sa, const ctpsa_t *ma[], int sb, const ctpsa_t *mb[], int sc, ctpsa_t *mc[], ord_t lo, ord_t hi);
 void     mad_ctpsa_minv    (int sa, const ctpsa_t *ma[],                              int sc, ctpsa_t *mc[]);
 void     mad_ctpsa_pminv   (int sa, const ctpsa_t *ma[],                              int sc, ctpsa_t *mc[], int row_select[]);
+void     mad_ctpsa_eval    (int sa, const ctpsa_t *ma[], int sb, const cnum_t tb[],      int sc, cnum_t tc[]);
+void     mad_ctpsa_map_eval(int sa, const ctpsa_t *ma[], int np, const cnum_t x [],              cnum_t r []); // x[np][nv], r[np][sa]
 
 // I/O
 void     mad_ctpsa_print    (const ctpsa_t *t, str_t name_, FILE *stream_);
@@ -198,6 +208,7 @@ ctpsa_t* mad_ctpsa_scan     (                               FILE *stream_); // T
 desc_t*  mad_ctpsa_scan_hdr (                               FILE *stream_);
 void     mad_ctpsa_scan_coef(      ctpsa_t *t,              FILE *stream_); // TODO
 void     mad_ctpsa_debug    (const ctpsa_t *t);
+void     mad_ctpsa_debug_mt (int sa, const ctpsa_t *ma[], int nr, ctpsa_t *mc[]); // mc[nr][sa] = exp(ma) o ma, runs in parallel
 
 #define  mad_ctpsa_ordv(...) mad_ctpsa_ordv(__VA_ARGS__,NULL)
 
@@ -28,6 +28,8 @@
  o----------------------------------------------------------------------------o
  */
 
+#define _POSIX_C_SOURCE 200809L // for the tables cache (mmap)
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -37,16 +39,37 @@
 #include "mad_mem.h"
 #include "mad_desc_impl.h"
 
+#ifdef POSIX_VERSION
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef _OPENMP
+#include <stdint.h>
+#include <pthread.h>
+#endif
+#endif
+
 // --- GLOBALS ----------------------------------------------------------------
 
 const ord_t mad_tpsa_default   = -1;
 const ord_t mad_tpsa_same      = -2;
       int   mad_tpsa_strict    =  0;
+      int   mad_tpsa_sparse    =  4;
+      int   mad_tpsa_newton    =  1;
+
+#ifdef _OPENMP
+      int   mad_desc_tid       = -1;
+#else
+      int   mad_desc_tid       =  0;
+#endif
 
 // --- CONSTANTS --------------------------------------------------------------
 
 const ord_t desc_max_order = CHAR_BIT * sizeof(bit_t);
-const int   desc_max_temps = sizeof(((desc_t*)0)->t)/sizeof(*((desc_t*)0)->t);
+const int   desc_max_temps = sizeof(((desc_t*)0)->tmp.t)/sizeof(*((desc_t*)0)->tmp.t);
+
+enum { desc_max_threads = 256 }; // number of threads with their own temps
 
 // --- HELPERS ----------------------------------------------------------------
 
@@ -451,14 +474,21 @@ tbl_set_H(D *d)
 
 // --- L indexing matrix ------------------------------------------------------
 
+static inline size_t
+tbl_icsz(const D *d)
+{
+  // size of ic in L and in the streams of Ls
+  return d->i16 ? sizeof(uint16_t) : sizeof(idx_t);
+}
+
 static inline void
-tbl_print_LC(const idx_t *lc, int oa, int ob, int *pi)
+tbl_print_LC(const D *d, const void *lc, int oa, int ob)
 {
-  int iao = pi[oa], ibo = pi[ob], cols = pi[oa+1] - pi[oa];
+  const int *pi = d->ord2idx, iao = pi[oa], ibo = pi[ob], cols = pi[oa+1] - pi[oa];
   for (int ib = pi[ob]; ib < pi[ob+1]; ++ib) {
     printf("\n  ");
     for (int ia = pi[oa]; ia < pi[oa+1]; ++ia) {
-      int ic = lc[hpoly_idx(ib-ibo,ia-iao,cols)];
+      int ic = mad_desc_lc(d, lc, hpoly_idx(ib-ibo,ia-iao,cols));
       printf("%3d ", ic);
     }
   }
@@ -469,14 +499,14 @@ static inline void
 tbl_print_L(const D *d)
 {
   int ho = d->mo / 2;
-  for (int oc = 2; oc <= MIN(d->mo,5); ++oc)
+  for (int oc = 2; oc <= MIN(d->Lo,5); ++oc)
     for (int j = 1; j <= oc/2; ++j) {
       int oa = oc - j, ob = j;
       printf("L[%d][%d] = {", ob, oa);
-      tbl_print_LC(d->L[oa*ho + ob], oa, ob, d->ord2idx);
+      tbl_print_LC(d, d->L[oa*ho + ob], oa, ob);
     }
-  if (d->mo > 5)
-    printf("Orders 5 to %d omitted...\n", d->mo);
+  if (d->Lo > 5)
+    printf("Orders 5 to %d omitted...\n", d->Lo);
 }
 
 static inline idx_t*
@@ -528,59 +558,133 @@ tbl_build_LC(int oa, int ob, D *d)
 static inline int**
 get_LC_idxs(int oa, int ob, D *d)
 {
-  int oc = oa + ob;
-  const idx_t *pi = d->ord2idx, *lc = d->L[d->mo/2*oa + ob],
-                T = (pi[oc+1] + pi[oc] - 1) / 2;  // splitting threshold of oc
+  // rows: [start] [split 1] .. [split np-1] [end], where split p is the first
+  // ia with ic >= T(p) = pi[oc] + p*(pi[oc+1]-pi[oc])/np, i.e. the part p of
+  // the row [split p, split p+1) computes the part p of the coefs of order oc.
+  // lc is not packed yet (see tbl_pack_LC)
+  const int np = desc_nparts, oc = oa + ob;
+  const idx_t *pi = d->ord2idx, *lc = d->L[d->mo/2*oa + ob];
   const int  cols =  pi[oa+1] - pi[oa],
              rows =  pi[ob+1] - pi[ob];
 
-  int **LC_idx = mad_malloc(3 * sizeof *LC_idx);
+  int **LC_idx = mad_malloc((np+1) * sizeof *LC_idx);
   assert(LC_idx);
-  d->size += 3 * sizeof *LC_idx;
+  d->size += (np+1) * sizeof *LC_idx;
 
-  int *limits = mad_malloc(3 * rows * sizeof *limits); // rows: [start split end]
+  int *limits = mad_malloc((np+1) * rows * sizeof *limits);
   assert(limits);
-  d->size += 3 * rows * sizeof *limits;
-
-  const int START = 0, SPLIT = 1, END = 2;
+  d->size += (np+1) * rows * sizeof *limits;
 
-  LC_idx[START] = limits;
-  LC_idx[SPLIT] = limits +   rows;
-  LC_idx[END  ] = limits + 2*rows;
+  for (int p = 0; p <= np; ++p)
+    LC_idx[p] = limits + p*rows;
 
   for (int ib = 0; ib < rows; ++ib) {
     int ia;
     for (ia = 0; lc[hpoly_idx(ib,ia,cols)] == -1; ++ia)
       ;  // shift ia to first valid entry
-    LC_idx[START][ib] = ia;
+    LC_idx[0][ib] = ia;
 
     for (ia = oa == ob ? ib : cols-1; lc[hpoly_idx(ib,ia,cols)] == -1; --ia)
       ;  // shift ia to last valid entry
-    LC_idx[END  ][ib] = ia + 1;
+    LC_idx[np][ib] = ia + 1;
 
-    LC_idx[SPLIT][ib] = oa == ob ? ib+1 : cols;
-    for (ia = LC_idx[START][ib]; ia < LC_idx[END][ib]; ++ia)
-      if (lc[hpoly_idx(ib,ia,cols)] >= T) {
-        LC_idx[SPLIT][ib] = ia;
-        break;
-      }
+    for (int p = 1; p < np; ++p) {
+      idx_t T = pi[oc] + p*(pi[oc+1]-pi[oc])/np;  // splitting threshold
+      for (ia = LC_idx[p-1][ib]; ia < LC_idx[np][ib]; ++ia)
+        if (lc[hpoly_idx(ib,ia,cols)] >= T) break;
+      LC_idx[p][ib] = ia;
+    }
   }
 
 #ifdef DEBUG
   if (oc <= 5) {
-    printf("LC_idx[%d][%d] = { [T=%d]\n", ob, oa, T);
-    printf("  -->\t  //\t<--\n");
-    for (int r = 0; r < rows; ++r)
-      printf("  [%3d\t%3d\t%3d]\n", LC_idx[START][r],LC_idx[SPLIT][r],LC_idx[END][r]);
+    printf("LC_idx[%d][%d] = {\n", ob, oa);
+    for (int r = 0; r < rows; ++r) {
+      printf("  [");
+      for (int p = 0; p <= np; ++p) printf("%4d", LC_idx[p][r]);
+      printf(" ]\n");
+    }
   }
 #endif
 
   return LC_idx;
 }
 
+static inline idx_t*
+tbl_build_LS(int oa, int ob, D *d)
+{
+  // valid entries of L as branch-free streams, grouped by runs of consecutive
+  // ia within each row and part (split of L_idx), the diagonal of triangular
+  // matrices being a run on its own. Layout (rows = nb, np = desc_nparts):
+  // ls[np*ib+p] .. ls[np*ib+p+1] = runs of row ib in part p
+  // r[3*k+0..2]                = ia, length, start in s of the run k
+  // s[]                        = ic of all runs, uint16_t if i16
+  // lc is not packed yet (see tbl_pack_LC)
+  const idx_t *pi = d->ord2idx, *lc = d->L[d->mo/2*oa + ob];
+  int **LC_idx = d->L_idx[d->mo/2*oa + ob];
+  const int np   = desc_nparts,
+            cols = pi[oa+1] - pi[oa],
+            rows = pi[ob+1] - pi[ob];
+
+  idx_t *ls = NULL, *r = NULL;
+  void  *s  = NULL;
+  int nr = 0, ne = 0;
+
+  for (int pass = 0; pass < 2; ++pass) { // count, then fill
+    if (pass) {
+      int size = (np*rows+1 + 3*nr) * sizeof *ls + ne * tbl_icsz(d);
+      ls = mad_malloc(size);
+      assert(ls);
+      d->size += size;
+      r = ls + np*rows+1, s = r + 3*nr, ls[0] = 0;
+    }
+    nr = ne = 0;
+    for (int ib = 0; ib < rows; ++ib)
+      for (int h = 0; h < np; ++h) {
+        int prv = -2;
+        for (int ia = LC_idx[h][ib]; ia < LC_idx[h+1][ib]; ++ia) {
+          int ic = lc[hpoly_idx(ib,ia,cols)];
+          if (ic < 0) { prv = -2; continue; }
+          if (ia != prv+1 || (oa == ob && ia == ib)) {
+            if (pass) r[3*nr] = ia, r[3*nr+1] = 0, r[3*nr+2] = ne;
+            nr += 1;
+          }
+          if (pass) {
+            r[3*(nr-1)+1] += 1;
+            if (d->i16) ((uint16_t*)s)[ne] = ic;
+            else        ((idx_t   *)s)[ne] = ic;
+          }
+          ne += 1, prv = ia;
+        }
+        if (pass) ls[np*ib+h+1] = nr;
+      }
+  }
+  return ls;
+}
+
+static inline void*
+tbl_pack_LC(int oa, int ob, D *d)
+{
+  // convert lc to uint16_t if i16, once L_idx and Ls are built
+  const idx_t *pi = d->ord2idx;
+  idx_t *lc = d->L[d->mo/2*oa + ob];
+  if (!d->i16) return lc;
+
+  int mat_size = (pi[oa+1] - pi[oa]) * (pi[ob+1] - pi[ob]);
+  uint16_t *lc16 = mad_malloc(mat_size * sizeof *lc16);
+  assert(lc16);
+  for (int i = 0; i < mat_size; ++i)
+    lc16[i] = lc[i] < 0 ? UINT16_MAX : lc[i];
+
+  mad_free(lc);
+  d->size -= mat_size * (sizeof *lc - sizeof *lc16);
+  return lc16;
+}
+
 static inline void
 tbl_set_L(D *d)
 {
+  // tables themselves are built by order on demand, see tbl_build_L
   ord_t o = d->mo, ho = d->mo / 2;
   int size_L = (o*ho + 1) * sizeof *(d->L);
   d->L = mad_malloc(size_L);
@@ -592,18 +696,44 @@ tbl_set_L(D *d)
   assert(d->L_idx);
   d->size += size_lci;
 
+  d->Ls = mad_malloc(size_L);
+  assert(d->Ls);
+  d->size += size_L;
+
+  d->Lsz = mad_malloc((o+1) * sizeof *(d->Lsz));
+  assert(d->Lsz);
+  d->size += (o+1) * sizeof *(d->Lsz);
+
   memset(d->L,     0, size_L);
   memset(d->L_idx, 0, size_lci);
-  // #ifdef _OPENMP
-  // #pragma omp parallel for schedule(guided,1)
-  // #endif
-  for (int oc = 2; oc <= d->mo; ++oc)
+  memset(d->Ls,    0, size_L);
+  memset(d->Lsz,   0, (o+1) * sizeof *(d->Lsz));
+  d->Lo  = 1;  // orders 0 and 1 need no table
+  d->i16 = d->nc <= UINT16_MAX;
+}
+
+static inline void
+tbl_build_L(D *d, ord_t o)
+{
+  // build the tables of orders Lo+1..o, then publish the new Lo
+  ord_t ho = d->mo / 2;
+  for (int oc = d->Lo+1; oc <= o; ++oc) {
+    size_t size = d->size;
     for (int j = 1; j <= oc / 2; ++j) {
       int oa = oc - j, ob = j;
 
       d->L    [oa*ho + ob] = tbl_build_LC(oa, ob, d);
       d->L_idx[oa*ho + ob] = get_LC_idxs (oa, ob, d);
+      d->Ls   [oa*ho + ob] = tbl_build_LS(oa, ob, d);
+      d->L    [oa*ho + ob] = tbl_pack_LC (oa, ob, d);
     }
+    d->Lsz[oc] = d->size - size;
+  }
+
+#ifdef _OPENMP
+  #pragma omp atomic write seq_cst
+#endif
+  d->Lo = o;
 
 #ifdef DEBUG
   tbl_print_L(d);
@@ -613,15 +743,15 @@ tbl_set_L(D *d)
 // --- TABLE TEST --------------------------------------------------------------
 
 static inline int
-tbl_check_L(D *d)
+tbl_check_L(D *d, ord_t lo, ord_t hi)
 {
   assert(d && d->ord2idx && d->L && d->var_ords && d->To && d->H);
   int ho = d->mo / 2, *pi = d->ord2idx;
   ord_t m[d->nv];
-  for (int oc = 2; oc <= d->mo; ++oc)
+  for (int oc = MAX(lo,2); oc <= hi; ++oc)
     for (int j = 1; j <= oc / 2; ++j) {
       int oa = oc - j, ob = j;
-      idx_t *lc = d->L[oa*ho + ob];
+      const void *lc = d->L[oa*ho + ob];
       if (!lc)                                   return  1e7 + oa*1e3 + ob;
 
       int sa = pi[oa+1]-pi[oa], sb = pi[ob+1]-pi[ob];
@@ -634,7 +764,7 @@ tbl_check_L(D *d)
           if (il < 0)                              return -2e7 - ia*1e5 - ib;
           if (il >= sa * sb)                       return  2e7 + ia*1e5 + ib;
 
-          int ic = lc[il];
+          int ic = mad_desc_lc(d, lc, il);
           if (ic >= pi[oc+1])                      return  3e7 + ic*1e5 + 11;
           if (ic >= 0 && ic < d->ord2idx[oc]) return  3e7 + ic*1e5 + 12;
 
@@ -642,6 +772,18 @@ tbl_check_L(D *d)
           if (ic < 0 && mad_desc_mono_isvalid(d,d->nv,m))
                                                    return -3e7          - 13;
         }
+
+        // parts of the row must compute disjoint parts of order oc
+        int **LC_idx = d->L_idx[oa*ho + ob], np = desc_nparts;
+        for (int ial = 0; ial < lim_a; ++ial) {
+          int ic = mad_desc_lc(d, lc, hpoly_idx(ibl,ial,sa)), p = 0;
+          if (ic < 0) continue;
+          while (p < np && LC_idx[p+1][ibl] <= ial) ++p;
+          if (ial < LC_idx[0][ibl] || p == np)     return  4e7 + ic*1e5 + 14;
+          if (ic <  pi[oc] +  p   *(pi[oc+1]-pi[oc])/np ||
+              ic >= pi[oc] + (p+1)*(pi[oc+1]-pi[oc])/np)
+                                                   return  4e7 + ic*1e5 + 15;
+        }
       }
     }
   return 0;
@@ -673,97 +815,521 @@ tbl_check(D *d)
     if (! mad_mono_equ(nv,To[tv2to[i]],Tv[i])) return 6e6 + i;
     if (! mad_mono_equ(nv,To[i],monos + nv*i)) return 7e6 + i;
   }
-  return tbl_check_L(d);
+  return tbl_check_L(d, 2, d->Lo);
 }
 
-// --- THREAD DISPATCH ---------------------------------------------------------
+// --- LAZY L tables -----------------------------------------------------------
+
+void
+mad_desc_setL (D *d, ord_t o)
+{
+  // slow path of mad_desc_needL, tables of order <= Lo are never modified
+  assert(d);
+  o = MIN(o, d->mo);
+
+#ifdef _OPENMP
+  #pragma omp critical(desc_L)
+#endif
+  if (d->Lo < o) {
+    ord_t lo = d->Lo;
+    tbl_build_L(d, o);
+
+    int err = tbl_check_L(d, lo+1, o);
+    if (err != 0) {
+      printf("\nCheking L tables consistency ... %d\n", err);
+      assert(NULL);
+    }
+  }
+}
+
+// --- PARALLEL MUL ------------------------------------------------------------
+
+/*
+  Parallel mul runs the tasks (order, part) of c, see get_LC_idxs, over the
+  OpenMP threads with dynamic scheduling, highest orders first. It pays off
+  from the order of c where the time saved on the ops of the mul exceeds
+  mul_par_gain times the cost of the parallel region. The cost of a kernel op
+  and of a parallel region are measured on the first descriptor build.
+*/
+
+static inline long long
+get_ops(const D *d, int o)
+{
+  // number of kernel ops of the order o of a dense mul
+  const idx_t *pi = d->ord2idx;
+  long long ops = 0;
+  for (int j = 1; j <= (o-1)/2; ++j) {
+    int oa = o-j, ob = j;            // oa > ob >= 1
+    ops += 2LL * (pi[oa+1] - pi[oa]) * (pi[ob+1] - pi[ob]);
+  }
+  if (!(o & 1)) {
+    int ho = o/2;
+    ops += (long long)(pi[ho+1] - pi[ho]) * (pi[ho+1] - pi[ho]);
+  }
+  return ops;
+}
+
+#ifdef _OPENMP
+enum { mul_par_gain = 4 };
+
+static struct {
+  int    nth;           // number of threads, 0 if not measured
+  double op, par;       // seconds per kernel op, per parallel region
+} mul_cost;
 
 static inline void
-get_ops(D *d, long long int ops[])
+mul_cost_measure(void)
 {
-  int *pi = d->ord2idx;
+  enum { n = 1 << 14, nc = 1 << 12, nrep = 32 };
+  static num_t cc[nc], ca[n];
+  static idx_t ic[n];
+  double t0, s = 0;
+
+  // kernel op: scatter-add over an index stream
+  for (int i = 0; i < n; ++i)
+    ca[i] = 1e-3*i, ic[i] = (i * 2654435761u) % nc;
+  t0 = omp_get_wtime();
+  for (int r = 0; r < nrep; ++r)
+    for (int i = 0; i < n; ++i)
+      cc[ic[i]] += ca[i]*ca[r];
+  mul_cost.op = (omp_get_wtime() - t0) / ((double)nrep*n);
+
+  // parallel region with dynamic schedule of the tasks, after warm up
+  int nth = omp_get_max_threads(), nt = nth*desc_nparts;
+  for (int r = 0; r <= nrep; ++r) {
+    if (r == 1) t0 = omp_get_wtime();
+    #pragma omp parallel for schedule(dynamic,1) reduction(+:s)
+    for (int t = 0; t < nt; ++t)
+      s += cc[t % nc];
+  }
+  mul_cost.par = (omp_get_wtime() - t0) / nrep;
+  (void)s;
+  mul_cost.nth = nth;
+}
+#endif
+
+static inline void
+set_mul_par(D *d)
+{
+  d->mpo = d->mo+1;  // never
+#ifdef _OPENMP
+  if (!mul_cost.nth) {
+    if (omp_in_parallel()) return;  // nested, cannot measure
+    mul_cost_measure();
+  }
+  if (mul_cost.nth < 2) return;
+
+  double gain = 1 - 1.0/mul_cost.nth;
+  long long ops = 0;
   for (int o = 2; o <= d->mo; ++o) {
-    ops[o] = 0;
-    for (int j = 1; j <= (o-1)/2; ++j) {
-      int oa = o-j, ob = j;            // oa > ob >= 1
-      int na = pi[oa+1] - pi[oa], nb = pi[ob+1] - pi[ob];
-      ops[o] += 2 * na * nb;
-    }
-    if (!(o & 1)) {
-      int ho = o/2;
-      ops[o] += (pi[ho+1]-pi[ho]) * (pi[ho+1]-pi[ho]);
+    ops += get_ops(d, o);
+    if (ops * mul_cost.op * gain > mul_par_gain * mul_cost.par) {
+      d->mpo = o;
+      break;
     }
   }
-  if (d->mo >= 12) {
-    ops[d->mo]   /= 2;
-    ops[d->mo+1] = ops[d->mo];
+
+#ifdef DEBUG
+  printf("parallel mul from order %d (op=%.3g ns, par=%.3g us)\n",
+         d->mpo, mul_cost.op*1e9, mul_cost.par*1e6);
+#endif
+#endif
+}
+
+// --- THREAD temps -----------------------------------------------------------
+
+static inline void
+tmp_set(D *d, struct desc_tmp *tmp)
+{
+  assert(d && tmp);
+  mad_arena_push(-1); // temps live with d, not in the arena of the caller
+  for (int i=0; i < desc_max_temps; i++) {
+    tmp-> t[i] = mad_tpsa_newd (d,d->mo);
+    tmp->ct[i] = mad_ctpsa_newd(d,d->mo);
   }
+  mad_arena_pop();
 }
 
+static inline void
+tmp_del(struct desc_tmp *tmp)
+{
+  assert(tmp);
+  for (int i=0; i < desc_max_temps; i++) {
+    mad_tpsa_del (tmp-> t[i]);
+    mad_ctpsa_del(tmp->ct[i]);
+  }
+}
+
+/*
+  Thread ids index the temps of the descriptors, they are given on first use
+  and returned to the free list when the thread exits (POSIX only, through a
+  thread-specific key), i.e. the temps of a dead thread go to the next new one.
+*/
+
+#ifdef _OPENMP
+static int tid_nxt = 0, tid_nfree = 0, tid_free[desc_max_threads];
+
 static inline int
-get_min_dispatched_idx(int nb_threads, long long int dops[])
-{
-  long long int min_disp = dops[nb_threads-1];
-  int min_disp_idx = nb_threads - 1;
-  for (int t = nb_threads-1; t >= 0; --t)
-    if (dops[t] <= min_disp) {
-      min_disp = dops[t];
-      min_disp_idx = t;
+tid_get (void)
+{
+  int tid = -1;
+  #pragma omp critical (desc_tid)
+  {
+    if (tid_nfree) tid = tid_free[--tid_nfree];
+    else if (tid_nxt < desc_max_threads) tid = tid_nxt++;
+  }
+  return tid;
+}
+
+static void
+tid_put (void *tid_)
+{
+  // key destructor, the key holds tid+1 (NULL is not destroyed)
+  int tid = (int)(intptr_t)tid_ - 1;
+  #pragma omp critical (desc_tid)
+  tid_free[tid_nfree++] = tid;
+}
+
+#ifdef POSIX_VERSION
+static pthread_key_t  tid_key;
+static pthread_once_t tid_once = PTHREAD_ONCE_INIT;
+
+static void
+tid_key_new (void)
+{
+  pthread_key_create(&tid_key, tid_put);
+}
+#endif
+#endif
+
+struct desc_tmp*
+mad_desc_thtmp (D *d)
+{
+  // slow path of mad_desc_tmp, i.e. threads other than the first one
+  assert(d);
+#ifdef _OPENMP
+  if (mad_desc_tid < 0) {
+    int tid = tid_get();
+    ensure(tid >= 0 && "Too many threads using descriptors.");
+    mad_desc_tid = tid;
+#ifdef POSIX_VERSION
+    pthread_once(&tid_once, tid_key_new);
+    pthread_setspecific(tid_key, (void*)(intptr_t)(tid+1));
+#else
+    (void)tid_put;
+#endif
+  }
+  if (mad_desc_tid > 0) {
+    // slot owned by the calling thread, no lock needed
+    struct desc_tmp **tmp = &d->ths[mad_desc_tid-1];
+    if (!*tmp) {
+      *tmp = mad_malloc(sizeof **tmp);
+      assert(*tmp);
+      tmp_set(d, *tmp);
+    }
+    return *tmp;
+  }
+#endif
+  return &d->tmp;
+}
+
+// --- DESC hash --------------------------------------------------------------
+
+static inline unsigned long long
+desc_hash(int nmv, const ord_t map_ords[nmv], int nv, const ord_t ords[nv], ord_t ko)
+{
+  // FNV-1a hash of the definition (without variables names)
+  unsigned long long h = 14695981039346656037ull;
+#define HASH(v) (h = (h ^ (unsigned char)(v)) * 1099511628211ull)
+  HASH(nmv); HASH(nv); HASH(ko);
+  for (int i = 0; i < nmv; ++i) HASH(map_ords[i]);
+  for (int i = 0; i < nv ; ++i) HASH(ords[i]);
+#undef HASH
+  return h;
+}
+
+// --- TABLES CACHE -----------------------------------------------------------
+
+/*
+  The tables built by desc_build are saved in dir/desc-<hash>.bin where hash is
+  computed from the key (nmv, map_ords, nv, var_ords, ko), and mapped read-only
+  from the file next time the same descriptor is built, i.e. shared by all the
+  processes of a node. The file starts with the header and the key (checked),
+  followed by the offsets of the sections (i.e. tables) aligned on 8 bytes and
+  in the order given by cache_secs. Files are written under a temporary name
+  and renamed, so concurrent processes only see complete files. The cache is
+  best effort: any error falls back to build the tables, including a file whose
+  offsets do not match the layout of cache_secs (see cache_check).
+*/
+
+static char *cache_dir = NULL;
+
+enum { cache_version = 4 };
+
+struct cache_hdr {
+  char   magic[8];           // "MADDESC"
+  int    version, nmv, nv, nc, ns, np; // ns = number of sections, np = desc_nparts
+  ord_t  mo, ko, so, si;     // so = sizeof(ord_t), si = sizeof(idx_t)
+  size_t size;               // size of the file
+};
+
+static inline size_t
+cache_align (size_t n)
+{
+  return (n + 7) & ~(size_t)7;
+}
+
+static inline int
+cache_nsecs (ord_t mo)
+{
+  int n = 6;
+  for (int oc = 2; oc <= mo; ++oc)
+    n += 3 * (oc/2);
+  return n;
+}
+
+static inline int
+cache_secs (const D *d, const void *p[], size_t s[])
+{
+  // sections of the tables in the order of the file
+  const idx_t *pi = d->ord2idx;
+  int n = 0, ho = d->mo/2, np = desc_nparts;
+
+#define SECB(ptr,sz) (p[n] = (ptr), s[n++] = (sz))
+#define SEC(ptr,cnt) SECB(ptr, (cnt) * sizeof *(ptr))
+  SEC(d->monos  , d->nc * d->nv);
+  SEC(d->ords   , d->nc);
+  SEC(d->ord2idx, d->mo + 2);
+  SEC(d->tv2to  , d->nc);
+  SEC(d->to2tv  , d->nc);
+  SEC(d->H      , d->nv * (d->mo+2));
+
+  for (int oc = 2; oc <= d->mo; ++oc)
+    for (int j = 1; j <= oc / 2; ++j) {
+      int oa = oc - j, ob = j, i = oa*ho + ob;
+      int cols = pi[oa+1] - pi[oa], rows = pi[ob+1] - pi[ob];
+      const idx_t *ls = d->Ls[i], *r = ls + np*rows+1;
+      int nr = ls[np*rows], ne = nr ? r[3*nr-1] + r[3*nr-2] : 0;
+      SECB(d->L[i]      , rows * cols * tbl_icsz(d));
+      SEC(*d->L_idx[i]  , (np+1) * rows);
+      SECB(ls           , (np*rows+1 + 3*nr) * sizeof *ls + ne * tbl_icsz(d));
     }
-  return min_disp_idx;
+#undef SECB
+#undef SEC
+
+  assert(n == cache_nsecs(d->mo));
+  return n;
 }
 
+static inline int
+cache_name (const D *d, char *name, size_t size)
+{
+  unsigned long long h = desc_hash(d->nmv, d->map_ords, d->nv, d->var_ords, d->ko);
+  int n = snprintf(name, size, "%s/desc-%016llx.bin", cache_dir, h);
+  return n > 0 && (size_t)n < size;
+}
+
+static inline int
+cache_write (FILE *f, const void *ptr, size_t size)
+{
+  static const char pad[8];
+  size_t n = cache_align(size) - size;
+  return fwrite(ptr, 1, size, f) == size && fwrite(pad, 1, n, f) == n;
+}
+
+#ifdef POSIX_VERSION
+
 static inline void
-build_dispatch(D *d)
-{
-  int nb_threads = omp_get_num_procs();
-  d->ocs = mad_malloc(nb_threads * sizeof *(d->ocs));
-  assert(d->ocs);
-  d->size += nb_threads * sizeof *(d->ocs);
-
-  int sizes[nb_threads];
-  for (int t = 0; t < nb_threads; ++t) {
-    d->ocs[t] = mad_calloc(d->mo, sizeof *d->ocs[t]);
-    d->size += d->mo * sizeof *d->ocs[t];
-    sizes[t] = 0;
-  }
+cache_save (D *d)
+{
+  if (!cache_dir) return;
+  mad_desc_setL(d, d->mo);  // all tables are saved
+
+  int ns = cache_nsecs(d->mo);
+  const void *p[ns];
+  size_t s[ns], off[ns];
+  cache_secs(d, p, s);
+
+  struct cache_hdr hdr = { "MADDESC", cache_version, d->nmv, d->nv, d->nc, ns,
+                           desc_nparts, d->mo, d->ko, sizeof(ord_t), sizeof(idx_t), 0 };
+  size_t pos = cache_align(sizeof hdr + d->nmv + d->nv) + cache_align(sizeof off);
+  for (int i = 0; i < ns; ++i)
+    off[i] = pos, pos += cache_align(s[i]);
+  hdr.size = pos;
+
+  size_t len = strlen(cache_dir) + 64;
+  char name[len], tmp[len+32];
+  if (!cache_name(d, name, len)) return;
+  static int cnt = 0; // temporary name unique per process and call
+  int k;
+  #ifdef _OPENMP
+  #pragma omp atomic capture
+  #endif
+  k = cnt++;
+  snprintf(tmp, sizeof tmp, "%s.%ld.%d", name, (long)getpid(), k);
+
+  FILE *f = fopen(tmp, "wb");
+  if (!f) return;
+
+  char key[sizeof hdr + d->nmv + d->nv];
+  memcpy(key, &hdr, sizeof hdr);
+  memcpy(key + sizeof hdr         , d->map_ords, d->nmv);
+  memcpy(key + sizeof hdr + d->nmv, d->var_ords, d->nv );
+
+  int ok = cache_write(f, key, sizeof key) && cache_write(f, off, sizeof off);
+  for (int i = 0; ok && i < ns; ++i)
+    ok = cache_write(f, p[i], s[i]);
+
+  if (fclose(f) || !ok || rename(tmp, name))
+    remove(tmp);
+}
+
+static inline int
+cache_check (const D *d, const char *base, size_t size, int nc)
+{
+  // offsets must follow the layout of cache_secs for the nc monomials of d, the
+  // sizes of the L sections depend on ord2idx and on the runs counts of Ls
+  // that are read from the file, hence checked before use
+  const int ns = cache_nsecs(d->mo), np = desc_nparts;
+  const size_t icsz = nc <= UINT16_MAX ? sizeof(uint16_t) : sizeof(idx_t);
+  size_t pos = cache_align(sizeof(struct cache_hdr) + d->nmv + d->nv);
+  if (nc <= 0 || nc > max_nc(d->nv, d->mo) || pos + ns * sizeof(size_t) > size)
+    return 0;
 
-  long long int ops[d->mo+1], dops[nb_threads];
-  memset(dops, 0, nb_threads * sizeof *dops);
-  get_ops(d,ops);
+  const size_t *off = (const size_t*)(base + pos);
+  int n = 0;
+  pos += cache_align(ns * sizeof *off);
+
+#define FITS(sz) (off[n] == pos && pos <= size && (size_t)(sz) <= size - pos)
+#define SEC(sz)  do { if (!FITS(sz)) return 0; pos += cache_align(sz), ++n; } while (0)
+  SEC(nc * d->nv * sizeof *d->monos);
+  SEC(nc * sizeof *d->ords);
+  SEC((d->mo+2) * sizeof *d->ord2idx);
+  SEC(nc * sizeof *d->tv2to);
+  SEC(nc * sizeof *d->to2tv);
+  SEC(d->nv * (d->mo+2) * sizeof *d->H);
+
+  // indexes used by cache_load and by the sizes of the L sections
+  const idx_t *pi = (const idx_t*)(base + off[2]), *tv2to = (const idx_t*)(base + off[3]);
+  if (pi[0] != 0 || pi[d->mo+1] != nc) return 0;
+  for (int o = 0; o <= d->mo; ++o)
+    if (pi[o] > pi[o+1]) return 0;
+  for (int i = 0; i < nc; ++i)
+    if (tv2to[i] < 0 || tv2to[i] >= nc) return 0;
 
-  if (nb_threads == 1 || d->mo < 12) {
-    for (int o = d->mo; o >= 2; --o) {
-      d->ocs[0][sizes[0]++] = o;
-      dops[0] += ops[o];
+  for (int oc = 2; oc <= d->mo; ++oc)
+    for (int j = 1; j <= oc / 2; ++j) {
+      int oa = oc - j, ob = j;
+      size_t cols = pi[oa+1] - pi[oa], rows = pi[ob+1] - pi[ob];
+      SEC(rows * cols * icsz);
+      SEC((np+1) * rows * sizeof ***d->L_idx);
+
+      // runs count and last run of Ls give its size
+      const idx_t *ls = (const idx_t*)(base + pos), *r = ls + np*rows+1;
+      if (!FITS((np*rows+1) * sizeof *ls) || ls[np*rows] < 0) return 0;
+      size_t nr = ls[np*rows];
+      if (!FITS((np*rows+1 + 3*nr) * sizeof *ls)) return 0;
+      idx_t rn = nr ? r[3*nr-2] : 0, rs = nr ? r[3*nr-1] : 0;
+      if (rn < 0 || rs < 0) return 0;
+      SEC((np*rows+1 + 3*nr) * sizeof *ls + ((size_t)rs + rn) * icsz);
     }
+#undef SEC
+#undef FITS
+
+  return n == ns && pos == size;
+}
+
+static inline int
+cache_load (D *d)
+{
+  if (!cache_dir) return 0;
+
+  size_t len = strlen(cache_dir) + 64;
+  char name[len];
+  if (!cache_name(d, name, len)) return 0;
+
+  int fd = open(name, O_RDONLY);
+  if (fd < 0) return 0;
+
+  struct stat st;
+  void *map = MAP_FAILED;
+  if (!fstat(fd, &st) && (size_t)st.st_size >= sizeof(struct cache_hdr))
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return 0;
+
+  // check header and key
+  const struct cache_hdr *hdr = map;
+  const ord_t *key = (const ord_t*)(hdr+1);
+  int ns = cache_nsecs(d->mo);
+  if (memcmp(hdr->magic, "MADDESC", 8) || hdr->version != cache_version
+      || hdr->so  != sizeof(ord_t) || hdr->si  != sizeof(idx_t)
+      || hdr->nmv != d->nmv || hdr->nv != d->nv || hdr->ko != d->ko
+      || hdr->mo  != d->mo  || hdr->ns != ns    || hdr->size != (size_t)st.st_size
+      || hdr->np  != desc_nparts || hdr->size < sizeof *hdr + d->nmv + d->nv
+      || !mad_mono_equ(d->nmv, key, d->map_ords)
+      || !mad_mono_equ(d->nv , key+d->nmv, d->var_ords)
+      || !cache_check(d, map, st.st_size, hdr->nc)) {
+    munmap(map, st.st_size);
+    return 0;
   }
-  else {
-    for (int o = d->mo + 1; o >= 2; --o) {
-      int idx = get_min_dispatched_idx(nb_threads,dops);
-      assert(idx >= 0 && idx < nb_threads);
-      d->ocs[idx][sizes[idx]++] = o;
-      dops[idx] += ops[o];
+
+  // set tables, pointers tables are rebuilt
+  const char   *base = map;
+  const size_t *off  = (const size_t*)(base + cache_align(sizeof *hdr + d->nmv + d->nv));
+  int n = 0;
+
+#define SEC(ptr) ((ptr) = (void*)(base + off[n++]))
+  d->nc  = hdr->nc;
+  d->i16 = d->nc <= UINT16_MAX;
+  SEC(d->monos); SEC(d->ords); SEC(d->ord2idx); SEC(d->tv2to); SEC(d->to2tv); SEC(d->H);
+
+  tbl_by_ord(d);
+  d->Tv = mad_malloc(d->nc * sizeof *d->Tv);
+  assert(d->Tv);
+  d->size += d->nc * sizeof *d->Tv;
+  for (int i = 0; i < d->nc; ++i)
+    d->Tv[i] = d->To[d->tv2to[i]];
+
+  ord_t o = d->mo, ho = d->mo / 2;
+  int size_L = (o*ho + 1) * sizeof *(d->L), size_lci = (o*ho + 1) * sizeof *(d->L_idx);
+  d->L     = mad_calloc(1, size_L  );
+  d->L_idx = mad_calloc(1, size_lci);
+  d->Ls    = mad_calloc(1, size_L  );
+  d->Lsz   = mad_calloc(o+1, sizeof *(d->Lsz));
+  assert(d->L && d->L_idx && d->Ls && d->Lsz);
+  d->size += 2*size_L + size_lci + (o+1) * sizeof *(d->Lsz);
+
+  const idx_t *pi = d->ord2idx;
+  const int np = desc_nparts;
+  for (int oc = 2; oc <= d->mo; ++oc)
+    for (int j = 1; j <= oc / 2; ++j) {
+      int oa = oc - j, ob = j, i = oa*ho + ob, rows = pi[ob+1] - pi[ob];
+      int **LC_idx = mad_malloc((np+1) * sizeof *LC_idx);
+      assert(LC_idx);
+      d->size += (np+1) * sizeof *LC_idx;
+      SEC(d->L[i]); SEC(LC_idx[0]); SEC(d->Ls[i]);
+      for (int p = 1; p <= np; ++p)
+        LC_idx[p] = LC_idx[0] + p*rows;
+      d->L_idx[i] = LC_idx;
+      d->Lsz[oc] += (n < ns ? off[n] : hdr->size) - off[n-3] + (np+1) * sizeof *LC_idx;
     }
-  }
+#undef SEC
+  d->Lo = d->mo;
 
-#ifdef DEBUG
-  printf("\nTHREAD DISPATCH:\n");
-  for (int t = 0; t < nb_threads; ++t) {
-    printf("[%d]: ", t);
-    for (int i = 0; d->ocs[t][i]; ++i)
-      printf("%d ", d->ocs[t][i]);
-    printf("[ops:%lld] \n", dops[t]);
-  }
-  printf("\n");
-#endif
+  d->map = map, d->map_size = st.st_size;
+  d->size += st.st_size;
+  return 1;
 }
 
-// --- DESC management ---------------------------------------------------------
+#else // no cache
 
-enum { TPSA_DESC_NUM = 100 };    // number of descriptors to store
+static inline void cache_save (      D *d) { (void)d; }
+static inline int  cache_load (      D *d) { (void)d; return 0; }
+
+#endif
 
-static D  *Ds[TPSA_DESC_NUM];
+// --- DESC management ---------------------------------------------------------
 
 static inline void
 set_var_ords(D *d, const ord_t ords[])
@@ -844,18 +1410,22 @@ desc_build(int nmv, const ord_t map_ords[nmv], str_t var_nam_[nmv], int nv, cons
 
   set_var_ords(d, ords);
   set_var_names(d, var_nam_);
-  make_monos(d);
-  tbl_by_ord(d);
-  tbl_by_var(d);  // requires To
-  tbl_set_H(d);
-  tbl_set_L(d);
-  build_dispatch(d);
-
-  // set temps
-  for(int i=0; i < desc_max_temps; i++) {
-    d-> t[i] = mad_tpsa_newd (d,d->mo);
-    d->ct[i] = mad_ctpsa_newd(d,d->mo);
+
+  int cached = cache_load(d);
+  if (!cached) {
+    make_monos(d);
+    tbl_by_ord(d);
+    tbl_by_var(d);  // requires To
+    tbl_set_H(d);
+    tbl_set_L(d);
   }
+  set_mul_par(d);
+
+  // set temps, other threads build theirs on first use
+  tmp_set(d, &d->tmp);
+  d->ths = mad_malloc((desc_max_threads-1) * sizeof *d->ths);
+  assert(d->ths);
+  memset(d->ths, 0, (desc_max_threads-1) * sizeof *d->ths);
 
   // TODO: add the size of the temps to d->size
 
@@ -863,7 +1433,7 @@ desc_build(int nmv, const ord_t map_ords[nmv], str_t var_nam_[nmv], int nv, cons
   printf("nc = %d ---- Total desc size: %d bytes\n", d->nc, d->size);
 #endif
 
-  int err = tbl_check(d);
+  int err = cached ? 0 : tbl_check(d);  // cached tables were checked when saved
   if (err != 0) {
     printf("\nA= ");   mad_mono_print(d->nv, d->var_ords);
     printf("\nH=\n");  tbl_print_H(d);
@@ -873,6 +1443,8 @@ desc_build(int nmv, const ord_t map_ords[nmv], str_t var_nam_[nmv], int nv, cons
     assert(NULL);
   }
 
+  if (!cached)
+    cache_save(d);
   return d;
 }
 
@@ -897,30 +1469,161 @@ desc_equiv(const D *d, int nmv, const ord_t map_ords[nmv], str_t var_nam_[nmv],
          && d->ko  == ko;
 }
 
-static inline D*
-desc_search(int nmv, const ord_t map_ords[nmv], str_t var_nam_[nmv], int nv, const ord_t ords[nv], ord_t ko)
+static inline void
+desc_free(D *d)
 {
-  for (int i = 0; i < TPSA_DESC_NUM; ++i) {
-    if (Ds[i] && desc_equiv(Ds[i], nmv,map_ords,var_nam_, nv,ords, ko))
-      return Ds[i];
+  assert(d);
+  mad_free(d->var_ords);
+  mad_free(d->sort_var);
+  mad_free(d->map_ords);
+  mad_free(d->To);
+  mad_free(d->Tv);
+  if (!d->map) {  // mapped tables are released by munmap
+    mad_free(d->monos);
+    mad_free(d->ords);
+    mad_free(d->ord2idx);
+    mad_free(d->tv2to);
+    mad_free(d->to2tv);
+    mad_free(d->H);
+  }
+
+  if (d->var_names_) {
+    for (int i = 0; i < d->nmv; ++i)
+      mad_free(d->var_names_[i]);
+    mad_free(d->var_names_);
+  }
+
+  if (d->L) {  // if L exists, then L_idx and Ls exist too
+    for (int i = 0; i < 1 + d->mo * (d->mo/2); ++i) {
+      if (!d->map) {
+        mad_free(d->L [i]);
+        mad_free(d->Ls[i]);
+        if (d->L_idx[i])
+          mad_free(*d->L_idx[i]);  // allocated as single block
+      }
+      mad_free(d->L_idx[i]);
+    }
+    mad_free(d->L);
+    mad_free(d->L_idx);
+    mad_free(d->Ls);
+    mad_free(d->Lsz);
   }
+
+  tmp_del(&d->tmp);
+  for (int t = 0; t < desc_max_threads-1; ++t)
+    if (d->ths[t]) {
+      tmp_del(d->ths[t]);
+      mad_free(d->ths[t]);
+    }
+  mad_free(d->ths);
+
+#ifdef POSIX_VERSION
+  if (d->map)
+    munmap(d->map, d->map_size);
+#endif
+
+  mad_free(d);
+}
+
+// --- DESC registry -----------------------------------------------------------
+
+/*
+  Descriptors are shared: mad_desc_new returns the existing descriptor with the
+  same definition and increments its reference count, mad_desc_del decrements
+  it. Descriptors no longer referenced are kept for reuse in a LRU list, the
+  least recently used ones being destroyed beyond desc_max_unused. Registry
+  operations are serialized (critical section desc_reg), descriptors are built
+  and destroyed outside of it.
+*/
+
+enum { desc_max_unused = 8 };    // number of unused descriptors kept
+
+static struct {
+  D  **tbl;                      // hash table, buckets chained by D->nxt
+  int  size, cnt;                // table size (power of 2), #descriptors
+  D   *fst, *lst;                // unused descriptors, most recent first
+  int  nu, id;                   // #unused descriptors, last id
+} reg;
+
+static inline void
+reg_grow(void)
+{
+  int size = reg.size ? 2*reg.size : 64;
+  D **tbl = mad_calloc(size, sizeof *tbl);
+  assert(tbl);
+
+  for (int i = 0; i < reg.size; ++i)
+    for (D *d = reg.tbl[i], *n; d; d = n) {
+      n = d->nxt;
+      d->nxt = tbl[d->hash & (size-1)];
+      tbl[d->hash & (size-1)] = d;
+    }
+  mad_free(reg.tbl);
+  reg.tbl = tbl, reg.size = size;
+}
+
+static inline void
+reg_unlink(D *d)
+{
+  // remove d from the list of unused descriptors
+  if (d->uprv) d->uprv->unxt = d->unxt; else reg.fst = d->unxt;
+  if (d->unxt) d->unxt->uprv = d->uprv; else reg.lst = d->uprv;
+  d->uprv = d->unxt = NULL;
+  --reg.nu;
+}
+
+static inline void
+reg_remove(D *d)
+{
+  // remove d from the hash table
+  D **p = &reg.tbl[d->hash & (reg.size-1)];
+  while (*p != d) p = &(*p)->nxt;
+  *p = d->nxt;
+  --reg.cnt;
+}
+
+static inline D*
+desc_search(int nmv, const ord_t map_ords[nmv], str_t var_nam_[nmv], int nv, const ord_t ords[nv], ord_t ko, unsigned long long h)
+{
+  if (!reg.size) return NULL;
+  for (D *d = reg.tbl[h & (reg.size-1)]; d; d = d->nxt)
+    if (d->hash == h && desc_equiv(d, nmv,map_ords,var_nam_, nv,ords, ko))
+      return d;
   return NULL;
 }
 
 static inline D*
 get_desc(int nmv, const ord_t map_ords[nmv], str_t var_nam_[nmv], int nv, const ord_t ords[nv], ord_t ko)
 {
-  D *existing_desc = desc_search(nmv,map_ords,var_nam_, nv,ords, ko);
-  if (existing_desc)
-    return existing_desc;
-
-  for (int i = 0; i < TPSA_DESC_NUM; ++i)
-    if (!Ds[i]) {
-      Ds[i] = desc_build(nmv,map_ords,var_nam_, nv,ords, ko);
-      Ds[i]->id = i;
-      return Ds[i];
+  // descriptors are built outside of the lock (errors must not leave it held),
+  // the one built by a concurrent thread for the same definition may win
+  unsigned long long h = desc_hash(nmv,map_ords, nv,ords, ko);
+  D *d, *n = NULL;
+
+  for (;;) {
+    #ifdef _OPENMP
+    #pragma omp critical(desc_reg)
+    #endif
+    {
+      d = desc_search(nmv,map_ords,var_nam_, nv,ords, ko, h);
+      if (d) {
+        if (!d->ref++) reg_unlink(d);
+      }
+      else if (n) {
+        d = n, n = NULL;
+        d->id = ++reg.id, d->ref = 1, d->hash = h;
+        if (reg.cnt >= reg.size) reg_grow();
+        d->nxt = reg.tbl[h & (reg.size-1)];
+        reg.tbl[h & (reg.size-1)] = d;
+        ++reg.cnt;
+      }
     }
-  ensure(NULL && "Too many descriptors.");
+    if (d) break;
+    n = desc_build(nmv,map_ords,var_nam_, nv,ords, ko);
+  }
+
+  if (n) desc_free(n);
+  return d;
 }
 
 // --- Public Functions -------------------------------------------------------
@@ -996,6 +1699,17 @@ mad_desc_mono_nxtbyvar (const D *d, int n, ord_t m[n])
 
 // --- Public Functions -------------------------------------------------------
 
+void
+mad_desc_cachedir(str_t dir_)
+{
+  mad_free(cache_dir);
+  cache_dir = NULL;
+  if (dir_) {
+    cache_dir = mad_malloc(strlen(dir_)+1);
+    strcpy(cache_dir, dir_);
+  }
+}
+
 int
 mad_desc_maxsize(const D *d)
 {
@@ -1010,6 +1724,29 @@ mad_desc_maxord(const D *d)
   return d->mo;
 }
 
+void
+mad_desc_info(const D *d, FILE *fp_)
+{
+  assert(d);
+  if (!fp_) fp_ = stdout;
+
+  ord_t lo;
+#ifdef _OPENMP
+  #pragma omp atomic read seq_cst
+#endif
+  lo = d->Lo;
+
+  fprintf(fp_, "desc %d: nv=%d, nmv=%d, mo=%d, ko=%d, nc=%d, size=%zu bytes%s\n",
+          d->id, d->nv, d->nmv, d->mo, d->ko, d->nc, d->size, d->map ? " (mapped)" : "");
+  for (int oc = 2; oc <= d->mo; ++oc)
+    if (oc <= lo)
+      fprintf(fp_, "  L tables order %3d: %zu bytes\n", oc, d->Lsz[oc]);
+    else
+      fprintf(fp_, "  L tables order %3d: not built\n", oc);
+  if (d->mpo <= d->mo)
+    fprintf(fp_, "  parallel mul from order %d\n", d->mpo);
+}
+
 ord_t
 mad_desc_gtrunc(D *d, ord_t to)
 {
@@ -1054,7 +1791,6 @@ mad_desc_newk(int nv, const ord_t var_ords[nv], const ord_t map_ords_[nv], str_t
   ensure(nv && var_ords);
   // ensure(nk && knb_ords);
   ensure(dk <= mad_mono_ord(nk,knb_ords));
-  ensure(mad_mono_ord(nv,var_ords) + mad_mono_ord(nk,knb_ords) < desc_max_order);
 
   ord_t map_ords[nv];  // to parse optional param
   if (map_ords_) {
@@ -1066,6 +1802,7 @@ mad_desc_newk(int nv, const ord_t var_ords[nv], const ord_t map_ords_[nv], str_t
     ord_t mo = mad_mono_max(nv,var_ords);
     mad_mono_fill(nv,map_ords,mo);
   }
+  ensure(mad_mono_max(nv,map_ords) < desc_max_order);
   if (dk == 0) dk = mad_mono_max(nk,knb_ords);
   ensure(dk <= mad_mono_max(nv,map_ords));
 
@@ -1084,48 +1821,26 @@ void
 mad_desc_del(D *d)
 {
   assert(d);
-  mad_free(d->var_ords);
-  mad_free(d->map_ords);
-  mad_free(d->monos);
-  mad_free(d->ords);
-  mad_free(d->To);
-  mad_free(d->Tv);
-  mad_free(d->ord2idx);
-  mad_free(d->tv2to);
-  mad_free(d->to2tv);
-  mad_free(d->H);
-
-  if (d->var_names_) {
-    for (int i = 0; i < d->nmv; ++i)
-      mad_free(d->var_names_[i]);
-    mad_free(d->var_names_);
-  }
-
-  if (d->L) {  // if L exists, then L_idx exists too
-    for (int i = 0; i < 1 + d->mo * d->mo/2; ++i) {
-      mad_free(d->L[i]);
-      if (d->L_idx[i]) {
-        mad_free(*d->L_idx[i]);  // allocated as single block
-        mad_free( d->L_idx[i]);
+  D *u = NULL;
+  int ref;
+
+  #ifdef _OPENMP
+  #pragma omp critical(desc_reg)
+  #endif
+  {
+    ref = d->ref;
+    if (ref > 0 && !--d->ref) {
+      // most recent unused first, drop the least recently used beyond max
+      d->uprv = NULL, d->unxt = reg.fst;
+      if (reg.fst) reg.fst->uprv = d; else reg.lst = d;
+      reg.fst = d, ++reg.nu;
+      if (reg.nu > desc_max_unused) {
+        u = reg.lst;
+        reg_unlink(u);
+        reg_remove(u);
       }
     }
-    mad_free(d->L);
-    mad_free(d->L_idx);
-  }
-
-  if (d->ocs) {
-    int nb_threads = omp_get_num_procs();
-    for (int t = 0; t < nb_threads; ++t)
-      mad_free(d->ocs[t]);
-    mad_free(d->ocs);
   }
-
-  for(int i=0; i < desc_max_temps; i++) {
-    mad_tpsa_del (d-> t[i]);
-    mad_ctpsa_del(d->ct[i]);
-  }
-
-  // remove descriptor from global array
-  Ds[d->id] = NULL;
-  mad_free(d);
+  ensure(ref > 0 && "Descriptor already deleted.");
+  if (u) desc_free(u);
 }
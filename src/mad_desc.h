@@ -31,6 +31,8 @@
  o----------------------------------------------------------------------------o
  */
 
+#include <stdio.h>
+
 #include "mad_defs.h"
 #include "mad_mono.h"
 
@@ -43,6 +45,8 @@ typedef struct desc desc_t;
 extern const ord_t mad_tpsa_default;
 extern const ord_t mad_tpsa_same;
 extern       int   mad_tpsa_strict;
+extern       int   mad_tpsa_sparse;  // sparse mul if nnz*sparse < n, 0 = off
+extern       int   mad_tpsa_newton;  // newton minv if no knobs, 0 = fixed point
 
 // --- interface -------------------------------------------------------------o
 
@@ -52,10 +56,14 @@ desc_t* mad_desc_newk (int nv, const ord_t var_ords[], const ord_t map_ords_[],
                        int nk, const ord_t knb_ords[], ord_t dk); // knobs
 void    mad_desc_del  (desc_t *d);
 
+// tables cache, dir_ = NULL disables it (default)
+void    mad_desc_cachedir (str_t dir_);
+
 // introspection
 int     mad_desc_maxsize (const desc_t *d);
 ord_t   mad_desc_maxord  (const desc_t *d);
 ord_t   mad_desc_gtrunc  (      desc_t *d, ord_t to);
+void    mad_desc_info    (const desc_t *d, FILE *fp_); // sizes of tables by order
 
 // ---------------------------------------------------------------------------o
 
@@ -27,6 +27,15 @@
 
 // --- types -----------------------------------------------------------------o
 
+// parts of the coefs of each order in L_idx and Ls, i.e. tasks of parallel mul
+enum { desc_nparts = 8 };
+
+// temps are per thread, see mad_desc_tmp
+struct desc_tmp {
+   tpsa_t * t[5];      // temps for mul[0], fix pts[1-3], div & funs[4], alg funs[1-3] for aliasing
+  ctpsa_t *ct[5];      // temps for ctpsa
+};
+
 struct desc {
   int      id;         // WARNING: needs to be identical with Lua for compatibility
   int      nmv, nv, nc;// number of map vars, number of all vars, number of coeff
@@ -43,20 +52,35 @@ struct desc {
           *monos,      // 'matrix' storing the monomials (sorted by ord)
           *ords,       // order of each mono of To
          **To,         // Table by orders -- pointers to monos, sorted by order
-         **Tv,         // Table by vars   -- pointers to monos, sorted by vars
-         **ocs;        // ocs[t,i] = o; in mul, compute o on thread t; 3 <= o <= mo; terminated with 0
+         **Tv;         // Table by vars   -- pointers to monos, sorted by vars
 
   idx_t   *sort_var,   // array
           *ord2idx,    // order to polynomial start index in To (i.e. in TPSA coef[])
           *tv2to,      // lookup tv->to
           *to2tv,      // lookup to->tv
           *H,          // indexing matrix, in Tv
-         **L,          // multiplication indexes -- L[oa][ob] = lc; lc[ia][ib] = ic
-        ***L_idx;      // L_idx[oa,ob] = [start] [split] [end] idxs in L
+        ***L_idx,      // L_idx[oa,ob] = [start] [split 1..np-1] [end] idxs in L
+         **Ls;         // L streams  -- Ls[oa][ob] = [row runs] [runs (ia,n,is)] [ic]
+
+  void   **L;          // multiplication indexes -- L[oa][ob] = lc; lc[ia][ib] = ic
+  int      i16;        // ic in L and Ls are uint16_t if nc < 65536, idx_t otherwise
+  ord_t    mpo;        // parallel mul from this order of c (measured), > mo if never
+
+  ord_t    Lo;         // L, L_idx and Ls are built up to order Lo, see mad_desc_needL
+  size_t  *Lsz;        // bytes used by the tables of order oc in L, L_idx and Ls
+
+  void    *map;        // tables mapped from the cache file (read-only), or NULL
+  size_t   map_size;   // size of the mapping
+
+  // registry
+  int      ref;        // reference count, unused if 0
+  unsigned long long hash; // hash of the definition
+  struct desc *nxt,    // next in the hash table bucket
+              *uprv, *unxt; // prev and next in the list of unused descriptors
 
   // WARNING: temps must be used with care (internal side effects)
-   tpsa_t * t[5];      // temps for mul[0], fix pts[1-3], div & funs[4], alg funs[1-3] for aliasing
-  ctpsa_t *ct[5];      // temps for ctpsa
+  struct desc_tmp   tmp; // temps of the first thread using the descriptors
+  struct desc_tmp **ths; // temps of the other threads, ths[tid-1] built on first use
 };
 
 // --- interface -------------------------------------------------------------o
@@ -78,6 +102,34 @@ void     mad_ctpsa_del  (ctpsa_t *t);
 
 // --- helpers ---------------------------------------------------------------o
 
+// thread id for temps: -1 until first use, 0 for the first thread (no overhead)
+extern int mad_desc_tid;
+#ifdef _OPENMP
+#pragma omp threadprivate(mad_desc_tid)
+#endif
+
+struct desc_tmp* mad_desc_thtmp (D *d);
+
+static inline struct desc_tmp*
+mad_desc_tmp (D *d)
+{
+  return !mad_desc_tid ? &d->tmp : mad_desc_thtmp(d);
+}
+
+// multiplication tables are built by order on first use (thread-safe)
+void mad_desc_setL (D *d, ord_t o);
+
+static inline void
+mad_desc_needL (D *d, ord_t o)
+{
+  ord_t lo;
+#ifdef _OPENMP
+  #pragma omp atomic read seq_cst
+#endif
+  lo = d->Lo;
+  if (lo < o) mad_desc_setL(d, o);
+}
+
 #undef  ensure
 #define ensure(test) assert(test)
 
@@ -87,6 +139,17 @@ hpoly_idx (idx_t ib, idx_t ia, idx_t ia_size)
   return ib*ia_size + ia;
 }
 
+static inline idx_t
+mad_desc_lc (const D *d, const void *lc, idx_t i)
+{
+  // entry i of lc = L[oa][ob], -1 if invalid (stored as UINT16_MAX if i16)
+  if (d->i16) {
+    idx_t ic = ((const uint16_t*)lc)[i];
+    return ic == UINT16_MAX ? -1 : ic;
+  }
+  return ((const idx_t*)lc)[i];
+}
+
 // ---------------------------------------------------------------------------o
 
 #endif // MAD_DESC_IMPL_H
@@ -81,6 +81,7 @@ static const char *progname = "mad";
 #include <time.h>
 #include "lj_def.h"
 #include "mad_log.h"
+#include "mad_mem.h"
 
 #ifndef MAD_VERSION
 #define MAD_VERSION "0.2.0"
@@ -590,6 +591,8 @@ static int docall(lua_State *L, int narg, int clear)
 	lua_remove(L, base);  /* remove traceback function */
 	/* force a complete garbage collection in case of errors */
 	if (status != 0) lua_gc(L, LUA_GCCOLLECT, 0);
+	/* close the arena scopes left open by errors */
+	if (status != 0) mad_arena_reset(0);
 	return status;
 }
 
@@ -430,6 +430,94 @@
     r[i*ldr+i] OP##= x; \
 }
 
+// -----
+
+// [m x n] = [m x p] * [p x n]
+// blocked matrix-matrix multiplication for large matrices (see [1])
+// y is packed by blocks of [kc x nc] (L3), x by blocks of [mc x kc] (L2), and
+// the micro-kernel accumulates tiles of [mr x nr] in registers from panels of
+// [mr x kc] and [kc x nr] (L1). The kernel is vectorized by the compiler.
+// [1] K. Goto and R. A. van de Geijn, "Anatomy of High-Performance Matrix
+//     Multiplication", ACM Trans. Math. Softw. 34(3), 2008.
+
+enum { gemm_mr = 4, gemm_nr = 8 };                     // tiles (registers)
+enum { gemm_kc = 256, gemm_mc = 128, gemm_nc = 1024 }; // blocks (L1, L2, L3)
+enum { gemm_min = 1 << 15 };                           // min m*n*p (~32^3)
+
+static inline void
+gemm_pack_x (const num_t *x, num_t *a, ssz_t mc, ssz_t kc, ssz_t p)
+{
+  // x[mc x kc] -> panels of mr rows, column-major, zero padded
+  enum { MR = gemm_mr };
+  for (ssz_t i=0; i < mc; i += MR) {
+    ssz_t mr = MIN(MR, mc-i);
+    for (ssz_t k=0; k < kc; k++, a += MR)
+    for (ssz_t ii=0; ii < MR; ii++)
+      a[ii] = ii < mr ? x[(i+ii)*p+k] : 0;
+  }
+}
+
+static inline void
+gemm_pack_y (const num_t *y, num_t *b, ssz_t kc, ssz_t nc, ssz_t n)
+{
+  // y[kc x nc] -> panels of nr columns, row-major, zero padded
+  enum { NR = gemm_nr };
+  for (ssz_t j=0; j < nc; j += NR) {
+    ssz_t nr = MIN(NR, nc-j);
+    for (ssz_t k=0; k < kc; k++, b += NR)
+    for (ssz_t jj=0; jj < NR; jj++)
+      b[jj] = jj < nr ? y[k*n+j+jj] : 0;
+  }
+}
+
+static inline void
+gemm_kernel (const num_t *restrict a, const num_t *restrict b, num_t *restrict r,
+             ssz_t kc, ssz_t n, ssz_t mr, ssz_t nr)
+{
+  // r[mr x nr] += a[MR x kc] * b[kc x NR]
+  enum { MR = gemm_mr, NR = gemm_nr };
+  num_t c[MR][NR] = {{0}};
+  for (ssz_t k=0; k < kc; k++, a += MR, b += NR)
+    for (int i=0; i < MR; i++)
+    for (int j=0; j < NR; j++)
+      c[i][j] += a[i] * b[j];
+
+  for (ssz_t i=0; i < mr; i++)
+  for (ssz_t j=0; j < nr; j++)
+    r[i*n+j] += c[i][j];
+}
+
+static void
+gemm (const num_t x[], const num_t y[], num_t r[], ssz_t m, ssz_t n, ssz_t p)
+{
+  enum { MR = gemm_mr, NR = gemm_nr, KC = gemm_kc, MC = gemm_mc, NC = gemm_nc };
+  num_t *a = mad_malloc(MC*KC * sizeof *a);
+  num_t *b = mad_malloc(KC*MIN(n+NR,NC) * sizeof *b);
+  memset(r, 0, m*n * sizeof *r);
+
+  for (ssz_t jc=0; jc < n; jc += NC) {
+    ssz_t nc = MIN(NC, n-jc);
+    for (ssz_t pc=0; pc < p; pc += KC) {
+      ssz_t kc = MIN(KC, p-pc);
+      gemm_pack_y(y+pc*n+jc, b, kc, nc, n);
+      for (ssz_t ic=0; ic < m; ic += MC) {
+        ssz_t mc = MIN(MC, m-ic);
+        gemm_pack_x(x+ic*p+pc, a, mc, kc, p);
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(static) if ((long)mc*nc*kc >= gemm_min)
+        #endif
+        for (ssz_t jr=0; jr < nc; jr += NR)
+        for (ssz_t ir=0; ir < mc; ir += MR)
+          gemm_kernel(a+ir*kc, b+jr*kc, r+(ic+ir)*n+jc+jr,
+                      kc, n, MIN(MR, mc-ir), MIN(NR, nc-jr));
+      }
+    }
+  }
+
+  mad_free(b);
+  mad_free(a);
+}
+
 // --- mat
 
 void mad_mat_ident(num_t r[], ssz_t m, ssz_t n, ssz_t ldr)
@@ -454,7 +542,10 @@ void mad_mat_dotm (const num_t x[], const cnum_t y[], cnum_t r[], ssz_t m, ssz_t
 { CHKXYR; DOT(); }
 
 void mad_mat_mul (const num_t x[], const num_t y[], num_t r[], ssz_t m, ssz_t n, ssz_t p)
-{ CHKXYRXY; MUL(); }
+{ CHKXYRXY;
+  if (m >= gemm_mr && n >= gemm_nr && (long)m*n*p >= gemm_min) gemm(x,y,r,m,n,p);
+  else MUL();
+}
 
 void mad_mat_mulm (const num_t x[], const cnum_t y[], cnum_t r[], ssz_t m, ssz_t n, ssz_t p)
 { CHKXYRY; MUL(); }
@@ -1121,8 +1212,6 @@ mad_cmat_eigen (const cnum_t x[], cnum_t w[], cnum_t vl[], cnum_t vr[], ssz_t n)
 
 // -- FFT ---------------------------------------------------------------------o
 
-#include <fftw3.h>
-
 void // x [m x n] -> r [m, n/2+1]
 mad_mat_fft (const num_t x[], cnum_t r[], ssz_t m, ssz_t n)
 {
@@ -1137,27 +1226,21 @@ void // x [m x n] -> r [m, n/2+1]
 mad_mat_rfft (const num_t x[], cnum_t r[], ssz_t m, ssz_t n)
 {
   CHKXR;
-  fftw_plan p = fftw_plan_dft_r2c_2d(m, n, (num_t*)x, r, FFTW_ESTIMATE);
-  fftw_execute(p);
-  fftw_destroy_plan(p);
+  mad_fft_exec(mad_fft_r2c, m, n, x, r);
 }
 
 void
 mad_cmat_fft (const cnum_t x[], cnum_t r[], ssz_t m, ssz_t n)
 {
   CHKXR;
-  fftw_plan p = fftw_plan_dft_2d(m, n, (cnum_t*)x, r, FFTW_FORWARD, FFTW_ESTIMATE);
-  fftw_execute(p);
-  fftw_destroy_plan(p);
+  mad_fft_exec(mad_fft_fwd, m, n, x, r);
 }
 
 void
 mad_cmat_ifft(const cnum_t x[], cnum_t r[], ssz_t m, ssz_t n)
 {
   CHKXR;
-  fftw_plan p = fftw_plan_dft_2d(m, n, (cnum_t*)x, r, FFTW_BACKWARD, FFTW_ESTIMATE);
-  fftw_execute(p);
-  fftw_destroy_plan(p);
+  mad_fft_exec(mad_fft_bwd, m, n, x, r);
   mad_cvec_muln(r, 1.0/(m*n), r, m*n);
 }
 
@@ -1167,23 +1250,102 @@ mad_cmat_irfft (const cnum_t x[], num_t r[], ssz_t m, ssz_t n)
   CHKXR;
   ssz_t nn = m*(n/2+1);
   mad_alloc_tmp(cnum_t, cx, nn);
-  mad_cvec_copy(x, cx, nn);
-  fftw_plan p = fftw_plan_dft_c2r_2d(m, n, cx, r, FFTW_ESTIMATE);
-  fftw_execute(p);
-  fftw_destroy_plan(p);
+  mad_cvec_copy(x, cx, nn); // c2r destroys its input
+  mad_fft_exec(mad_fft_c2r, m, n, cx, r);
   mad_free_tmp(cx);
   mad_vec_muln(r, 1.0/(m*n), r, m*n);
 }
 
+// -- FFT of rows (e.g. turn-by-turn data of many BPMs)
+
+enum { fft_par_min = 1 << 16 }; // min #elements for parallel FFT of rows
+
+static void
+fft_rows (int kind, ssz_t m, ssz_t n, const void *x, void *r, size_t sx, size_t sr)
+{
+  // the threads transform chunks of rows, sx and sr are the rows sizes in bytes
+  int nt = 1;
+  #ifdef _OPENMP
+  if ((long)m*n >= fft_par_min && !omp_in_parallel())
+    nt = MIN(m, omp_get_max_threads());
+  #endif
+  ssz_t c = (m+nt-1)/nt;
+
+  #ifdef _OPENMP
+  #pragma omp parallel for num_threads(nt) schedule(static) if (nt > 1)
+  #endif
+  for (int t=0; t < nt; t++) {
+    ssz_t i = t*c, k = MIN(c, m-i);
+    if (k > 0)
+      mad_fft_exec(kind|mad_fft_rows, k, n, (const char*)x+i*sx, (char*)r+i*sr);
+  }
+}
+
+void // x [m x n] -> r [m x n]
+mad_mat_fft_rows (const num_t x[], cnum_t r[], ssz_t m, ssz_t n)
+{
+  CHKXR;
+  mad_alloc_tmp(cnum_t, cx, m*n);
+  mad_vec_copyv(x, cx, m*n);
+  mad_cmat_fft_rows(cx, r, m, n);
+  mad_free_tmp(cx);
+}
+
+void // x [m x n] -> r [m x n/2+1]
+mad_mat_rfft_rows (const num_t x[], cnum_t r[], ssz_t m, ssz_t n)
+{
+  CHKXR;
+  fft_rows(mad_fft_r2c, m, n, x, r, n*sizeof *x, (n/2+1)*sizeof *r);
+}
+
+void
+mad_cmat_fft_rows (const cnum_t x[], cnum_t r[], ssz_t m, ssz_t n)
+{
+  CHKXR;
+  fft_rows(mad_fft_fwd, m, n, x, r, n*sizeof *x, n*sizeof *r);
+}
+
+void
+mad_cmat_ifft_rows (const cnum_t x[], cnum_t r[], ssz_t m, ssz_t n)
+{
+  CHKXR;
+  fft_rows(mad_fft_bwd, m, n, x, r, n*sizeof *x, n*sizeof *r);
+  mad_cvec_muln(r, 1.0/n, r, m*n);
+}
+
+void // x [m x n/2+1] -> r [m x n]
+mad_cmat_irfft_rows (const cnum_t x[], num_t r[], ssz_t m, ssz_t n)
+{
+  CHKXR;
+  ssz_t nn = m*(n/2+1);
+  mad_alloc_tmp(cnum_t, cx, nn);
+  mad_cvec_copy(x, cx, nn); // c2r destroys its input
+  fft_rows(mad_fft_c2r, m, n, cx, r, (n/2+1)*sizeof *cx, n*sizeof *r);
+  mad_free_tmp(cx);
+  mad_vec_muln(r, 1.0/n, r, m*n);
+}
+
+// -- NAFF of rows (e.g. frequency map analysis), see mad_vec.c for details
+
+void // x [m x n] -> frq, amp, phs [m x k], nf [m]
+mad_cmat_naff (const cnum_t x[], num_t frq[], num_t amp[], num_t phs[], int nf_[],
+               ssz_t m, ssz_t n, ssz_t k)
+{
+  assert( x && frq && amp && phs );
+  ensure(n > 1 && k > 0, "invalid NAFF sizes (n=%d, k=%d)", n, k); // not in threads
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) if (m > 1)
+  #endif
+  for (ssz_t i=0; i < m; i++) {
+    int nf = mad_cvec_naff(x+i*n, frq+i*k, amp+i*k, phs+i*k, n, k);
+    if (nf_) nf_[i] = nf;
+  }
+}
+
 /* -- NFFT --------------------------------------------------------------------o
   see mad_vec.c for details
 */
 
-#include <nfft3.h>
-
-static nfft_plan p;
-static ssz_t p_n1, p_n2, p_m;
-
 void
 mad_mat_nfft (const num_t x[], const num_t x_node[], cnum_t r[], ssz_t m, ssz_t n, ssz_t nr)
 {
@@ -1197,50 +1359,13 @@ mad_mat_nfft (const num_t x[], const num_t x_node[], cnum_t r[], ssz_t m, ssz_t
 void // space to frequency
 mad_cmat_nfft (const cnum_t x[], const num_t x_node[], cnum_t r[], ssz_t m, ssz_t n, ssz_t nr)
 {
-  assert( x && r );
-  int precomp = 0;
-  if (m != p_n1 || n != p_n2 || nr != p_m) {
-    nfft_finalize(&p);
-    nfft_init_2d (&p, m, n, nr);
-    p_n1 = m, p_n2 = n, p_m = nr, precomp = 1;
-  }
-  if (x_node || precomp) {
-    for (ssz_t i=0; i < m*n; i++)  // adjoint transform needs -x_node
-      p.x[i] = x_node[i] == -0.5 ? 0.4999999999999999 : -x_node[i];
-    if(p.flags & PRE_ONE_PSI) nfft_precompute_one_psi(&p);
-  }
-  mad_cvec_copy(x, p.f, m*n);
-  const char *error_str = nfft_check(&p);
-  if (error_str) error("%s", error_str);
-  nfft_adjoint(&p); // nfft_adjoint_direct(&p);
-//  mad_cvec_copy(p.f_hat, r, nr);
-  mad_cvec_copy(p.f_hat+nr/2, r, nr/2); // for compatibility with FFTW ?? (TBC)
-  mad_cvec_copy(p.f_hat, r+nr/2, nr/2);
+  mad_nfft_exec(0, m, n, nr, x_node, x, r);
 }
 
 void // frequency to space
 mad_cmat_infft (const cnum_t x[], const num_t r_node[], cnum_t r[], ssz_t m, ssz_t n, ssz_t nx)
 {
-  assert( x && r );
-  int precomp = 0;
-  if (m != p_n1 || n != p_n2 || nx != p_m) {
-    nfft_finalize(&p);
-    nfft_init_2d (&p, m, n, nx);
-    p_n1 = m, p_n2 = n, p_m = nx, precomp = 1;
-  }
-  if (r_node || precomp) {
-    for (ssz_t i=0; i < m*n; i++) // forward transform needs -r_node
-      p.x[i] = r_node[i] == -0.5 ? 0.4999999999999999 : -r_node[i];
-    if(p.flags & PRE_ONE_PSI) nfft_precompute_one_psi(&p);
-  }
-  // mad_cvec_copy(x, p.f_hat, nx);
-  mad_cvec_copy(x+nx/2, p.f_hat, nx/2); // for compatibility with FFTW ?? (TBC)
-  mad_cvec_copy(x, p.f_hat+nx/2, nx/2);
-  const char *error_str = nfft_check(&p);
-  if (error_str) error("%s", error_str);
-  nfft_trafo(&p); // nfft_trafo_direct(&p);
-  mad_cvec_copy(p.f, r, m*n);
-  mad_cvec_muln(r, 1.0/(m*n), r, m*n);
+  mad_nfft_exec(1, m, n, nx, r_node, x, r);
 }
 
 // -- CLEANUP -----------------------------------------------------------------o
@@ -1248,6 +1373,6 @@ mad_cmat_infft (const cnum_t x[], const num_t r_node[], cnum_t r[], ssz_t m, ssz
 void
 mad_mat_cleanup(void)
 {
-  nfft_finalize(&p);  memset(&p, 0, sizeof p);
-  fftw_cleanup();
+  mad_nfft_cleanup();
+  mad_fft_cleanup();
 }
@@ -52,6 +52,8 @@ int    mad_mat_svd     (const  num_t x[], num_t u[], num_t s[],    num_t  v[], s
 int    mad_mat_eigen   (const  num_t x[], cnum_t w[], num_t vl[],  num_t vr[],          ssz_t n);                       //  w, vl, vr
 void   mad_mat_fft     (const  num_t x[],                         cnum_t  r[], ssz_t m, ssz_t n);                       //  mat ->cmat
 void   mad_mat_rfft    (const  num_t x[],                         cnum_t  r[], ssz_t m, ssz_t n);                       //  mat ->cmat
+void   mad_mat_fft_rows  (const  num_t x[],                       cnum_t  r[], ssz_t m, ssz_t n);                       //  mat ->cmat (rows)
+void   mad_mat_rfft_rows (const  num_t x[],                       cnum_t  r[], ssz_t m, ssz_t n);                       //  mat ->cmat (rows)
 void   mad_mat_nfft    (const  num_t x[], const num_t x_node[]  , cnum_t  r[], ssz_t m, ssz_t n, ssz_t nr);
 void   mad_mat_center  (const  num_t x[],                          num_t  r[], ssz_t m, ssz_t n, int d);                //  mat -> mat-<mat>_r
 void   mad_mat_sympinv (const  num_t x[],                          num_t  r[],          ssz_t n);                       //  -J M' J
@@ -84,7 +86,11 @@ void   mad_cmat_fft    (const cnum_t x[],                         cnum_t  r[], s
 void   mad_cmat_nfft   (const cnum_t x[], const num_t x_node[]   ,cnum_t  r[], ssz_t m, ssz_t n, ssz_t nr);
 void   mad_cmat_ifft   (const cnum_t x[],                         cnum_t  r[], ssz_t m, ssz_t n);                       //  cmat ->cmat
 void   mad_cmat_irfft  (const cnum_t x[],                          num_t  r[], ssz_t m, ssz_t n);                       //  cmat -> mat
+void   mad_cmat_fft_rows  (const cnum_t x[],                      cnum_t  r[], ssz_t m, ssz_t n);                       //  cmat ->cmat (rows)
+void   mad_cmat_ifft_rows (const cnum_t x[],                      cnum_t  r[], ssz_t m, ssz_t n);                       //  cmat ->cmat (rows)
+void   mad_cmat_irfft_rows(const cnum_t x[],                       num_t  r[], ssz_t m, ssz_t n);                       //  cmat -> mat (rows)
 void   mad_cmat_infft  (const cnum_t x[], const num_t r_node[]   ,cnum_t  r[], ssz_t m, ssz_t n, ssz_t nx);
+void   mad_cmat_naff   (const cnum_t x[], num_t frq[], num_t amp[], num_t phs[], int nf_[], ssz_t m, ssz_t n, ssz_t k); // cmat -> k freqs (rows)
 void   mad_cmat_center (const cnum_t x[],                         cnum_t  r[], ssz_t m, ssz_t n, int d);                //  cmat ->cmat-<cmat>_r
 void   mad_cmat_sympinv(const cnum_t x[],                         cnum_t  r[],          ssz_t n);                       //  -J M' J
 num_t  mad_cmat_symperr(const cnum_t x[],                         cnum_t  r[],          ssz_t n);                       //  M' J M - J
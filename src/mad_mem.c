@@ -35,10 +35,19 @@ Note about auto collect:
   If MAD_MEM_AUTOCOLLECT != 0, the memory allocator will bound the amount
   of cached memory to pool_max. Default is to bound the memory cached for
   OPENMP only. -DMAD_MEM_AUTOCOLLECT sets it to 1.
+
+Note about size classes:
+  Blocks above mblk_max and up to clss_max are rounded up to geometric size
+  classes (4 per power of 2) and cached per thread up to cach_cls bytes.
+  If MAD_MEM_RESERVOIR != 0, the blocks over this bound go to a global
+  reservoir of rsrv_max bytes shared by the threads, e.g. for blocks freed by
+  another thread than the one that allocated them. Default is to use the
+  reservoir for OPENMP only. -DMAD_MEM_RESERVOIR sets it to 1.
 */
 
 #ifdef _OPENMP
 #define MAD_MEM_AUTOCOLLECT 1
+#define MAD_MEM_RESERVOIR   1
 #endif
 
 #ifdef MAD_MEM_CHECKMARK
@@ -55,6 +64,12 @@ Note about auto collect:
 #define CAM(...) __VA_ARGS__
 #endif
 
+#ifdef  MAD_MEM_RESERVOIR
+#define RSV(...) __VA_ARGS__
+#else
+#define RSV(...)
+#endif
+
 // --- types & constants -----------------------------------------------------o
 
 // memory block
@@ -81,6 +96,12 @@ struct slot {
   union mblk *list;
 };
 
+// pool size classes (list of mblk and stats)
+struct clss {
+  union mblk *list;
+  size_t cnt, hits, miss;
+};
+
 #define MARK 0xDEADC0DE // marker
 
 // sizes & offsets
@@ -88,15 +109,26 @@ enum {
   mblk_stp = 1<< 4, // step size is 16 bytes
   mblk_max = 1<<11, // max object size is 2kB
   pool_max = 1<<24, // max cached size is 16MB
+  achk_min = 1<<16, // min arena chunk size is 64kB
+  arena_lvl = 64,   // max nested arena scopes
+  arena_bit = 1<<30,// slot bit of arena mblk
+  clss_bit = 1<<29, // slot bit of size class mblk
+  clss_sub = 4,     // size classes per power of 2
+  clss_lg2 = 22,    // max size class is 4MB
+  cach_cls = 1<<26, // max cached size in classes is 64MB per thread
+  rsrv_max = 1<<26, // max cached size in reservoir is 64MB
 
   slot_max = mblk_max/mblk_stp, // 128 slots
   cach_max = pool_max/mblk_stp, // 16MB in slots unit
+  clss_max = (clss_lg2-11)*clss_sub, // 44 classes above 2kB
   mblk_off = offsetof(union mblk, used.data),
 
   // sanity checks
   static_assert__mblk_stp_must_be_a_power_of_2 = 1/!(mblk_stp & (mblk_stp-1)),
   static_assert__mblk_max_must_be_a_power_of_2 = 1/!(mblk_max & (mblk_max-1)),
-  static_assert__pool_max_must_be_a_power_of_2 = 1/!(pool_max & (pool_max-1))
+  static_assert__pool_max_must_be_a_power_of_2 = 1/!(pool_max & (pool_max-1)),
+  static_assert__mblk_max_must_be_2kB_for_clss = 1/(mblk_max == 1<<11),
+  static_assert__clss_sub_must_be_4_for_clss   = 1/(clss_sub == 4)
 };
 
 // memory pool
@@ -104,16 +136,37 @@ struct pool {
 MAC(
   size_t cached; )
   struct slot slot[slot_max];
+  struct clss clss[clss_max];
+  size_t ccached; // in bytes
+};
+
+// arena chunk (list of chunks), mblk are bumped from data
+struct achk {
+  struct achk *next;
+  size_t size, used, _pad; // data is aligned like malloc
+  char data[];
+};
+
+// arena, chunks after cur are free
+struct arena {
+  int lvl;
+  struct achk *list, *cur;
+  struct { struct achk *cur; size_t used; int off; } mark[arena_lvl];
 };
 
 // --- locals ----------------------------------------------------------------o
 
-static struct pool pool[1];
+static struct pool  pool [1];
+static struct arena arena[1];
 
 #ifdef _OPENMP
-#pragma omp threadprivate(pool)
+#pragma omp threadprivate(pool, arena)
 #endif
 
+RSV(
+static struct clss rsrv[clss_max];
+static size_t      rsrv_cached; ) // in bytes
+
 // --- implementation --------------------------------------------------------o
 
 static inline union mblk*
@@ -135,6 +188,34 @@ get_size (size_t slot)
   return (slot+1) * mblk_stp + mblk_off;
 }
 
+static inline size_t
+get_clss (size_t size)
+{
+  // mblk_max < size <= 1<<clss_lg2, size-1 = 1.sub... x 2^e
+  size_t e = 63 - __builtin_clzll(size-1);
+  return (e-11)*clss_sub + (((size-1) >> (e-2)) & (clss_sub-1));
+}
+
+static inline size_t
+get_csize (size_t clss)
+{
+  size_t e = clss/clss_sub + 11, sub = clss%clss_sub;
+  return (clss_sub+sub+1) << (e-2);
+}
+
+static inline int
+is_clss (size_t slot)
+{
+  return (slot & (arena_bit | arena_bit<<1 | clss_bit)) == clss_bit;
+}
+
+static inline int
+is_arena (size_t slot)
+{
+  // size=0 slot has all bits set
+  return (slot & (arena_bit | arena_bit<<1)) == arena_bit;
+}
+
 static inline void*
 init_node (union mblk *ptr, size_t slot)
 {
@@ -143,11 +224,94 @@ CHK(ptr->used.mark = MARK; )
     return ptr->used.data;
 }
 
+// -- size classes
+
+static inline int
+in_clss (size_t size)
+{
+  return size > mblk_max && size <= (size_t)1 << clss_lg2;
+}
+
+#ifdef MAD_MEM_RESERVOIR
+static inline union mblk*
+rsrv_get (size_t clss)
+{
+  union mblk *ptr = NULL;
+  #pragma omp critical (mad_mem_rsrv)
+  if ((ptr = rsrv[clss].list)) {
+    rsrv[clss].list = ptr->free.next;
+    rsrv[clss].cnt -= 1;
+    rsrv_cached -= get_csize(clss);
+  }
+  return ptr;
+}
+
+static inline int
+rsrv_put (union mblk *ptr, size_t clss)
+{
+  int ok = 0;
+  #pragma omp critical (mad_mem_rsrv)
+  if (rsrv_cached + get_csize(clss) <= rsrv_max) {
+    ptr->free.next = rsrv[clss].list, rsrv[clss].list = ptr;
+    rsrv[clss].cnt += 1;
+    rsrv_cached += get_csize(clss);
+    ok = 1;
+  }
+  return ok;
+}
+#endif
+
+static inline void*
+clss_malloc (str_t fname, size_t size)
+{
+  size_t clss = get_clss(size);
+  struct pool *ppool = pool;
+  struct clss *pptr = ppool->clss+clss;
+  union  mblk *ptr  = pptr->list;
+
+  if (ptr) {
+    pptr->list = ptr->free.next, pptr->cnt -= 1, pptr->hits += 1;
+    ppool->ccached -= get_csize(clss);
+  }
+RSV(
+  else if ((ptr = rsrv_get(clss)))
+    pptr->hits += 1; )
+  else {
+    pptr->miss += 1;
+    ptr = malloc(get_csize(clss) + mblk_off);
+    if (!ptr) {
+      mad_mcollect();
+      ptr = malloc(get_csize(clss) + mblk_off);
+      if (!ptr)
+        (mad_error)(fname, "out of memory (%lu bytes)", (unsigned long)size);
+    }
+  }
+
+  return init_node(ptr, clss + clss_bit);
+}
+
+static inline void
+clss_free (union mblk *ptr, size_t clss)
+{
+  struct pool *ppool = pool;
+  struct clss *pptr = ppool->clss+clss;
+
+  if (ppool->ccached + get_csize(clss) <= cach_cls) {
+    ptr->free.next = pptr->list, pptr->list = ptr, pptr->cnt += 1;
+    ppool->ccached += get_csize(clss);
+  }
+RSV(
+  else if (rsrv_put(ptr, clss)) ; )
+  else free(ptr);
+}
+
 // -- allocator
 
 void*
 (mad_malloc) (str_t fname, size_t size)
 {
+  if (in_clss(size)) return clss_malloc(fname, size);
+
   size_t slot = get_slot(size);
   struct pool *ppool = pool;
   struct slot *pptr = ppool->slot+slot;
@@ -165,6 +329,7 @@ MAC(if (ppool->cached > cach_max) mad_mcollect(); )
       if (!ptr)
         (mad_error)(fname, "out of memory (%lu bytes)", (unsigned long)size);
     }
+    if (size && slot >= clss_bit) slot = clss_bit-1; // saturated (> 8GB)
   }
 
   return init_node(ptr, slot);
@@ -190,6 +355,23 @@ CHK(
   if (ptr->used.mark != MARK)
     (mad_error)(fname, "invalid pointer"); )
 
+  if (is_arena(ptr->used.slot)) { // move to the heap
+    size_t osz = (ptr->used.slot - arena_bit + 1) * mblk_stp;
+    return memcpy((mad_malloc)(fname, size), ptr_, osz < size ? osz : size);
+  }
+
+  // size classes: same class keeps the mblk, otherwise move it
+  size_t oslot = ptr->used.slot;
+  if (is_clss(oslot) || in_clss(size)) {
+    size_t osz = is_clss(oslot) ? get_csize(oslot-clss_bit) : (oslot+1)*mblk_stp;
+    if (is_clss(oslot) && in_clss(size) && get_clss(size) == oslot-clss_bit)
+      return ptr_;
+    void *nptr = (mad_malloc)(fname, size);
+    memcpy(nptr, ptr_, osz < size ? osz : size);
+    (mad_free)(fname, ptr_);
+    return nptr;
+  }
+
   size_t slot = get_slot(size);
 
 MAC(
@@ -203,6 +385,7 @@ MAC(
     if (!ptr)
       (mad_error)(fname, "out of memory (%lu bytes)", (unsigned long)size);
   }
+  if (slot >= clss_bit) slot = clss_bit-1; // saturated (> 8GB)
 
   return init_node(ptr, slot);
 }
@@ -228,10 +411,101 @@ CHK(
 MAC(  ppool->cached += slot+1;
       if (ppool->cached > cach_max) mad_mcollect(); )
     }
-    else free(ptr);
+    else if (is_clss(slot)) clss_free(ptr, slot-clss_bit);
+    else if (!is_arena(slot)) free(ptr); // arena mblk are freed by pop
   }
 }
 
+// -- arena
+
+static inline struct achk*
+arena_chunk (struct arena *parena, size_t size)
+{
+  // next free chunk with at least size bytes, free chunks too small are skipped
+  struct achk **pchk = parena->cur ? &parena->cur->next : &parena->list;
+  while (*pchk && (*pchk)->size < size) pchk = &(*pchk)->next;
+
+  if (!*pchk) {
+    size_t csz = parena->cur ? 2*parena->cur->size : achk_min;
+    if (csz > pool_max) csz = pool_max;
+    if (csz < size    ) csz = size;
+    struct achk *chk = malloc(sizeof *chk + csz);
+    if (!chk) {
+      mad_mcollect();
+      chk = malloc(sizeof *chk + csz);
+      if (!chk)
+        mad_error("out of memory (%lu bytes)", (unsigned long)csz);
+    }
+    chk->next = NULL, chk->size = csz;
+    *pchk = chk;
+  }
+
+  (*pchk)->used = 0;
+  return parena->cur = *pchk;
+}
+
+void*
+(mad_amalloc) (str_t fname, size_t size)
+{
+  struct arena *parena = arena;
+
+  if (!parena->lvl || parena->mark[parena->lvl-1].off || !size)
+    return (mad_malloc)(fname, size);
+
+  size_t slot = get_slot(size);
+  size_t asz  = (get_size(slot) + mblk_stp-1) & ~(size_t)(mblk_stp-1);
+  struct achk *chk = parena->cur;
+
+  if (!chk || chk->size - chk->used < asz)
+    chk = arena_chunk(parena, asz);
+
+  union mblk *ptr = (union mblk*)(chk->data + chk->used);
+  chk->used += asz;
+  return init_node(ptr, slot + arena_bit);
+}
+
+int
+mad_arena_push (ssz_t size_)
+{
+  struct arena *parena = arena;
+  ensure(parena->lvl < arena_lvl, "too many nested arenas (max %d)", arena_lvl);
+
+  int lvl = parena->lvl++;
+  parena->mark[lvl].cur  = parena->cur;
+  parena->mark[lvl].used = parena->cur ? parena->cur->used : 0;
+  parena->mark[lvl].off  = size_ < 0;
+
+  struct achk *chk = parena->cur;
+  if (size_ > 0 && (!chk || chk->size - chk->used < (size_t)size_))
+    arena_chunk(parena, size_);
+  return lvl;
+}
+
+void
+mad_arena_pop (void)
+{
+  struct arena *parena = arena;
+  ensure(parena->lvl > 0, "unbalanced arena pop");
+
+  int lvl = --parena->lvl;
+  parena->cur = parena->mark[lvl].cur;
+  if (parena->cur) parena->cur->used = parena->mark[lvl].used;
+}
+
+void
+mad_arena_reset (int lvl)
+{
+  // pop the scopes down to level lvl at once, i.e. as lvl-cur pops
+  struct arena *parena = arena;
+  ensure(0 <= lvl && lvl <= parena->lvl, "invalid arena level %d (current %d)",
+         lvl, parena->lvl);
+
+  if (lvl == parena->lvl) return;
+  parena->lvl = lvl;
+  parena->cur = parena->mark[lvl].cur;
+  if (parena->cur) parena->cur->used = parena->mark[lvl].used;
+}
+
 // -- utils
 
 void*
@@ -256,6 +530,8 @@ CHK(
     (mad_error)(fname, "invalid pointer"); )
 
   size_t slot = ptr->used.slot;
+  if (is_arena(slot)) slot -= arena_bit;
+  if (is_clss (slot)) return get_csize(slot-clss_bit);
   return slot != get_slot(0) ? (slot+1) * mblk_stp : 0;
 }
 
@@ -276,7 +552,22 @@ CAM(
 MAC(
   cached = ppool->cached; )
 
-  return cached * mblk_stp;
+  cached *= mblk_stp;
+
+  // size classes
+  cached += ppool->ccached;
+#ifdef MAD_MEM_RESERVOIR
+  #pragma omp critical (mad_mem_rsrv)
+  cached += rsrv_cached;
+#endif
+
+  // free arena chunks
+  struct arena *parena = arena;
+  struct achk *chk = parena->cur ? parena->cur->next : parena->list;
+  for (; chk; chk = chk->next)
+    cached += chk->size;
+
+  return cached;
 }
 
 // note: noinline improves speed of malloc and realloc for GCC 4.8 to 5.3
@@ -300,5 +591,64 @@ MAC(
   cached = ppool->cached;
   ppool->cached = 0; )
 
-  return cached * mblk_stp;
+  cached *= mblk_stp;
+
+  // size classes
+  for (int clss=0; clss < clss_max; clss++) {
+    struct clss *pptr = ppool->clss+clss;
+    for (ptr=pptr->list; ptr; ptr=nxt) {
+      nxt = ptr->free.next;
+      free(ptr);
+    }
+    pptr->list = 0, pptr->cnt = 0;
+  }
+  cached += ppool->ccached;
+  ppool->ccached = 0;
+
+#ifdef MAD_MEM_RESERVOIR
+  union mblk *rlst = 0;
+  #pragma omp critical (mad_mem_rsrv)
+  {
+    for (int clss=0; clss < clss_max; clss++) {
+      for (ptr=rsrv[clss].list; ptr; ptr=nxt) // move to a local list
+        nxt = ptr->free.next, ptr->free.next = rlst, rlst = ptr;
+      rsrv[clss].list = 0, rsrv[clss].cnt = 0;
+    }
+    cached += rsrv_cached;
+    rsrv_cached = 0;
+  }
+  for (ptr=rlst; ptr; ptr=nxt) {
+    nxt = ptr->free.next;
+    free(ptr);
+  }
+#endif
+
+  // free arena chunks
+  struct arena *parena = arena;
+  struct achk **pchk = parena->cur ? &parena->cur->next : &parena->list;
+  for (struct achk *chk = *pchk, *cnxt; chk; chk = cnxt) {
+    cnxt = chk->next;
+    cached += chk->size;
+    free(chk);
+  }
+  *pchk = NULL;
+
+  return cached;
+}
+
+int
+mad_mcstats (int n, size_t size_[n], size_t hits_[n], size_t miss_[n], size_t cached_[n])
+{
+  // size classes of the calling thread (without reservoir)
+  struct pool *ppool = pool;
+  if (n > clss_max) n = clss_max;
+
+  for (int clss=0; clss < n; clss++) {
+    struct clss *pptr = ppool->clss+clss;
+    if (size_  ) size_  [clss] = get_csize(clss);
+    if (hits_  ) hits_  [clss] = pptr->hits;
+    if (miss_  ) miss_  [clss] = pptr->miss;
+    if (cached_) cached_[clss] = pptr->cnt * get_csize(clss);
+  }
+  return clss_max;
 }
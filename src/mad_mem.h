@@ -32,8 +32,19 @@
   - mad_calloc calls mad_malloc and set to zeros the allocated memory.
   - mad_mcached returns the amount of memory cached (slow).
   - mad_mcollect frees the cached memory and returns its amount (slow).
+  - mad_mcstats fills the capacity, hits, misses and cached memory of the
+    size classes of the calling thread (up to n) and returns their number.
   - temporay buffers can be either on the stack or allocated with mad_malloc
     depending on their size, and must _always_ be locally freed.
+  - mad_arena_push opens a scope where mad_amalloc (used by the TPSA
+    constructors) takes blocks from a per-thread arena, mad_arena_pop
+    releases at once the blocks taken in the scope and mad_free on these
+    blocks does nothing. Scopes nest and must be balanced in the same thread.
+    size_ > 0 reserves memory for the scope, size_ < 0 opens a scope without
+    arena (i.e. for objects that must outlive the enclosing scopes).
+  - mad_arena_push returns the level before the push, mad_arena_reset pops the
+    scopes down to this level at once, e.g. those left open by an error raised
+    between push and pop (the error recovery of mad_main resets to level 0).
   - defining MAD_MEM_STD replaces mad allocator by C allocator
 
   Errors:
@@ -57,10 +68,18 @@
 #define mad_realloc( ptr_ , size_ )
 #define mad_free(    ptr_         )
 #define mad_msize(   ptr_         )
+#define mad_amalloc( size         ) // from the arena if any, see mad_arena_push
 
 // utils
 size_t mad_mcached  (void);
 size_t mad_mcollect (void);
+int    mad_mcstats  (int n, size_t size_[n], size_t hits_[n], size_t miss_[n],
+                     size_t cached_[n]);
+
+// arena (scoped temporaries)
+int    mad_arena_push  (ssz_t size_); // return level before push
+void   mad_arena_pop   (void);
+void   mad_arena_reset (int lvl);
 
 // --- implementation (private) ----------------------------------------------o
 
@@ -26,6 +26,7 @@
 #undef mad_realloc
 #undef mad_free
 #undef mad_msize
+#undef mad_amalloc
 
 #ifndef MAD_MEM_STD
 
@@ -34,6 +35,7 @@
 #define mad_realloc(p,s) mad_realloc(__func__, p,s)
 #define mad_free(p)      mad_free   (__func__, p)
 #define mad_msize(p)     mad_msize  (__func__, p)
+#define mad_amalloc(s)   mad_amalloc(__func__, s)
 
 #else
 
@@ -43,6 +45,7 @@
 #define mad_realloc(p,s) mad_mcheck(__func__, realloc(p,s))
 #define mad_free(p)                           free   (p)
 #define mad_msize(p)                                 (0)
+#define mad_amalloc(s)   mad_mcheck(__func__, malloc (s))
 
 #endif // MAD_MEM_STD
 
@@ -51,6 +54,7 @@ void*  (mad_calloc)   (str_t, size_t, size_t) __attribute__((hot,malloc));
 void*  (mad_realloc)  (str_t, void* , size_t) __attribute__((hot));
 void   (mad_free)     (str_t, void*)          __attribute__((hot));
 size_t (mad_msize)    (str_t, void*)          __attribute__((hot,const));
+void*  (mad_amalloc)  (str_t, size_t)         __attribute__((hot,malloc));
 void*  (mad_mcheck)   (str_t, void*)          __attribute__((hot,const));
 
 #undef  mad_alloc_tmp
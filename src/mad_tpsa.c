@@ -85,7 +85,7 @@ FUN(newd) (D *d, ord_t mo)
   if (mo == mad_tpsa_default) mo = d->mo;
   else ensure(mo <= d->mo);
 
-  T *t = mad_malloc(sizeof(T) + d->nc * sizeof(NUM));
+  T *t = mad_amalloc(sizeof(T) + d->nc * sizeof(NUM));
 
   t->d = d;
   t->lo = t->mo = mo;
@@ -111,11 +111,47 @@ FUN(copy) (const T *t, T *dst)
   dst->hi = MIN3(t->hi, dst->mo, d->trunc);
   dst->lo = t->lo;
   dst->nz = mad_bit_trunc(t->nz, dst->hi);
+  dst->coef[0] = t->coef[0]; // always valid, even if lo > 0
 
   for (int i = d->ord2idx[dst->lo]; i < d->ord2idx[dst->hi+1]; ++i)
     dst->coef[i] = t->coef[i];
 }
 
+void
+FUN(copy_ord) (const T *t, T *dst, ord_t lo, ord_t hi)
+{
+  // dst[lo..hi] = t[lo..hi], other orders of dst are left unchanged
+  assert(t && dst);
+  ensure(t->d == dst->d);
+  D *d = t->d;
+  hi = MIN3(hi, dst->mo, d->trunc);
+  if (t == dst || lo > hi) return;
+
+  const idx_t *pi = d->ord2idx;
+  const NUM *tc = t->coef;
+        NUM *dc = dst->coef;
+
+  // extend dst to [lo,hi], the gaps are zeroed like in acc
+  ord_t d_lo = lo, d_hi = hi;
+  if (dst->lo <= dst->hi) {
+    d_lo = MIN(lo, dst->lo), d_hi = MAX(hi, dst->hi);
+    for (int i = pi[d_lo     ]; i < pi[dst->lo]; ++i) dc[i] = 0;
+    for (int i = pi[dst->hi+1]; i < pi[d_hi+1]; ++i) dc[i] = 0;
+  }
+
+  // orders [lo,hi] of t, zero outside [t->lo,t->hi]
+  ord_t t_lo = MAX(lo, t->lo), t_hi = MIN(hi, t->hi);
+  if (t_lo > t_hi) t_lo = hi+1, t_hi = hi;
+  for (int i = pi[lo    ]; i < pi[t_lo  ]; ++i) dc[i] = 0;
+  for (int i = pi[t_lo  ]; i < pi[t_hi+1]; ++i) dc[i] = tc[i];
+  for (int i = pi[t_hi+1]; i < pi[hi+1  ]; ++i) dc[i] = 0;
+  if (!lo) dc[0] = tc[0]; // always valid, even if t->lo > 0
+
+  bit_t nz = dst->nz & ~mad_bit_lcut(mad_bit_trunc(dst->nz, hi), lo);
+  dst->nz = mad_bit_add(nz, mad_bit_lcut(mad_bit_trunc(t->nz, hi), lo));
+  dst->lo = d_lo, dst->hi = d_hi;
+}
+
 void
 FUN(clear) (T *t)
 {
@@ -225,8 +261,8 @@ FUN(set0) (T *t, NUM a, NUM b)
     t->lo = 0;
   }
   else {
-    int n = mad_bit_lowest(t->nz);
     t->nz = mad_bit_clr(t->nz,0);
+    int n = mad_bit_lowest(t->nz);
     t->lo = MIN(n,t->mo);
   }
 }
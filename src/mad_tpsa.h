@@ -46,6 +46,8 @@ typedef struct tpsa tpsa_t;
 extern const ord_t mad_tpsa_default;
 extern const ord_t mad_tpsa_same;
 extern       int   mad_tpsa_strict;
+extern       int   mad_tpsa_sparse;  // sparse mul if nnz*sparse < n, 0 = off
+extern       int   mad_tpsa_newton;  // newton minv if no knobs, 0 = fixed point
 
 // --- interface -------------------------------------------------------------o
 
@@ -61,6 +63,7 @@ ord_t   mad_tpsa_ordv    (const tpsa_t *t1, const tpsa_t *t2, ...);  // max orde
 
 // initialization
 void    mad_tpsa_copy    (const tpsa_t *t, tpsa_t *dst);
+void    mad_tpsa_copy_ord(const tpsa_t *t, tpsa_t *dst, ord_t lo, ord_t hi); // orders [lo,hi] only
 void    mad_tpsa_clear   (      tpsa_t *t);
 void    mad_tpsa_scalar  (      tpsa_t *t, num_t v);
 
@@ -92,9 +95,11 @@ void    mad_tpsa_mder    (const tpsa_t *a, tpsa_t *c, int n, const ord_t m[]);
 void    mad_tpsa_add     (const tpsa_t *a, const tpsa_t *b, tpsa_t *c);
 void    mad_tpsa_sub     (const tpsa_t *a, const tpsa_t *b, tpsa_t *c);
 void    mad_tpsa_mul     (const tpsa_t *a, const tpsa_t *b, tpsa_t *c);
+void    mad_tpsa_mul_ord (const tpsa_t *a, const tpsa_t *b, tpsa_t *c, ord_t lo, ord_t hi); // orders [lo,hi] only
 void    mad_tpsa_div     (const tpsa_t *a, const tpsa_t *b, tpsa_t *c);
 
 void    mad_tpsa_acc     (const tpsa_t *a, num_t v, tpsa_t *c);  // c += v*a, aliasing OK
+void    mad_tpsa_mulacc  (const tpsa_t *a, const tpsa_t *b, num_t v, tpsa_t *c); // c += v*a*b
 void    mad_tpsa_scl     (const tpsa_t *a, num_t v, tpsa_t *c);  // c  = v*a
 void    mad_tpsa_inv     (const tpsa_t *a, num_t v, tpsa_t *c);  // c  = v/a
 void    mad_tpsa_invsqrt (const tpsa_t *a, num_t v, tpsa_t *c);  // c  = v/sqrt(a)
@@ -147,9 +152,13 @@ void    mad_tpsa_ax2pby2pcz2(num_t a, const tpsa_t *x,
 
 // to check for non-homogeneous maps & knobs
 void    mad_tpsa_poisson (const tpsa_t *a, const tpsa_t *b, tpsa_t *c, int n);  // TO CHECK n
+void    mad_tpsa_poisson_ord(const tpsa_t *a, const tpsa_t *b, tpsa_t *c, int n, ord_t lo, ord_t hi);
 void    mad_tpsa_compose (int sa, const tpsa_t *ma[], int sb, const tpsa_t *mb[], int sc, tpsa_t *mc[]);
+void    mad_tpsa_compose_ord(int sa, const tpsa_t *ma[], int sb, const tpsa_t *mb[], int sc, tpsa_t *mc[], ord_t lo, ord_t hi);
 void    mad_tpsa_minv    (int sa, const tpsa_t *ma[],                             int sc, tpsa_t *mc[]);
 void    mad_tpsa_pminv   (int sa, const tpsa_t *ma[],                             int sc, tpsa_t *mc[], int row_select[]);
+void    mad_tpsa_eval    (int sa, const tpsa_t *ma[], int sb, const num_t tb[],      int sc, num_t tc[]);
+void    mad_tpsa_map_eval(int sa, const tpsa_t *ma[], int np, const num_t x [],              num_t r []); // x[np][nv], r[np][sa]
 
 // I/O
 void    mad_tpsa_print    (const tpsa_t *t, str_t name_, FILE *stream_);
@@ -157,6 +166,7 @@ tpsa_t* mad_tpsa_scan     (                              FILE *stream_); // TODO
 desc_t* mad_tpsa_scan_hdr (                              FILE *stream_);
 void    mad_tpsa_scan_coef(      tpsa_t *t,              FILE *stream_); // TODO
 void    mad_tpsa_debug    (const tpsa_t *t);
+void    mad_tpsa_debug_mt (int sa, const tpsa_t *ma[], int nr, tpsa_t *mc[]); // mc[nr][sa] = exp(ma) o ma, runs in parallel
 
 #define mad_tpsa_ordv(...) mad_tpsa_ordv(__VA_ARGS__,NULL)
 
@@ -21,6 +21,7 @@
 #include <string.h>
 #include <assert.h>
 
+#include "mad_mem.h"
 #include "mad_log.h"
 #include "mad_desc_impl.h"
 
@@ -54,10 +55,88 @@ check_compose(int sa, const T *ma[], int sb, const T *mb[], int sc, T *mc[])
   ensure(ma[0]->d == mc[0]->d);
 }
 
+#include "mad_tpsa_comp_s.tc"
 #ifdef _OPENMP
 #include "mad_tpsa_comp_p.tc"
 #endif
-#include "mad_tpsa_comp_s.tc"
+
+static inline void
+compose_to(int sa, const T *ma[], const T *mb[], T *mc[], ord_t to)
+{
+  // mc = ma o mb truncated at order to, d->trunc is left unchanged
+  #ifdef _OPENMP
+  // parallel from the order of the parallel mul, i.e. when products of the
+  // highest order are worth the threads (never for a single thread)
+  ord_t highest = 0;
+  for (int i = 0; i < sa; ++i)
+    if (ma[i]->hi > highest) highest = ma[i]->hi;
+
+  if (MIN(highest, to) >= ma[0]->d->mpo && !omp_in_parallel())
+    compose_parallel(sa,ma,mb,mc,to);
+  else
+  #endif // _OPENMP
+
+  compose_serial(sa,ma,mb,mc,to);
+}
+
+// --- eval
+
+enum { eval_blksz = 16 };          // points evaluated together
+enum { eval_par_min = 1 << 16 };   // min #points*#coefs for parallel eval
+
+static inline void
+eval_fathers(const D *d, ord_t hi, idx_t fa[], idx_t fv[])
+{
+  // To[c] = To[fa[c]] + e[fv[c]], the father is the same as in init_required
+  int nv = d->nv;
+  ord_t mono[nv];
+  for (int c = 1; c < d->ord2idx[hi+1]; ++c) {
+    int j;
+    mad_mono_copy(nv, d->To[c], mono);
+    for (j = nv-1; !mono[j]; --j) ;
+    mono[j]--;
+    fa[c] = mad_desc_get_idx(d, nv, mono), fv[c] = j;
+  }
+}
+
+static inline void
+eval_blk(int sa, const T *ma[], ord_t hi, int np, const NUM x[], NUM r[],
+         NUM pw[], const idx_t fa[], const idx_t fv[])
+{
+  // r[np][sa] = ma(x[np][nv]) for np <= eval_blksz, pw[nc][eval_blksz] powers
+  enum { B = eval_blksz };
+  D *d = ma[0]->d;
+  int nv = d->nv, *pi = d->ord2idx;
+  NUM xt[nv][B], s[B];
+
+  // transpose the points, missing ones are zero
+  for (int j = 0; j < nv; ++j)
+    for (int k = 0; k < B; ++k)
+      xt[j][k] = k < np ? x[k*nv+j] : 0;
+
+  // powers along To
+  for (int k = 0; k < B; ++k) pw[k] = 1;
+  for (int c = 1; c < pi[hi+1]; ++c) {
+    const NUM *f = pw + fa[c]*B, *xj = xt[fv[c]];
+          NUM *p = pw +     c*B;
+    for (int k = 0; k < B; ++k) p[k] = f[k] * xj[k];
+  }
+
+  // components
+  for (int i = 0; i < sa; ++i) {
+    const T *a = ma[i];
+    for (int k = 0; k < B; ++k) s[k] = a->coef[0];
+    for (int o = 1; o <= a->hi; ++o) {
+      if (!mad_bit_get(a->nz,o)) continue;
+      for (int c = pi[o]; c < pi[o+1]; ++c)
+        if (a->coef[c]) {
+          const NUM v = a->coef[c], *p = pw + c*B;
+          for (int k = 0; k < B; ++k) s[k] += v * p[k];
+        }
+    }
+    for (int k = 0; k < np; ++k) r[k*sa+i] = s[k];
+  }
+}
 
 // --- PUBLIC FUNCTIONS -------------------------------------------------------
 
@@ -65,16 +144,101 @@ void
 FUN(compose) (int sa, const T *ma[], int sb, const T *mb[], int sc, T *mc[])
 {
   check_compose(sa, ma, sb, mb, sc, mc);
+  compose_to(sa, ma, mb, mc, ma[0]->d->trunc);
+}
 
-  #ifdef _OPENMP
-  ord_t highest = 0;
+void
+FUN(compose_ord) (int sa, const T *ma[], int sb, const T *mb[], int sc, T *mc[],
+                  ord_t lo, ord_t hi)
+{
+  // mc[lo..hi] = (ma o mb)[lo..hi], other orders of mc are left unchanged
+  // orders above hi are not computed, orders below lo are needed by the powers
+  check_compose(sa, ma, sb, mb, sc, mc);
+
+  D *d = ma[0]->d;
+  hi = MIN(hi, d->trunc);
+  if (lo > hi) return;
+
+  T *mt[sc];
+  for (int i = 0; i < sc; ++i)
+    mt[i] = FUN(newd)(d, hi);
+
+  compose_to(sa, ma, mb, mt, hi);
+
+  for (int i = 0; i < sc; ++i) {
+    FUN(copy_ord)(mt[i], mc[i], lo, hi);
+    FUN(del)(mt[i]);
+  }
+}
+
+void
+FUN(map_eval) (int sa, const T *ma[], int np, const NUM x[], NUM r[])
+{
+  assert(ma && x && r);
+  ensure(sa > 0 && np >= 0);
+  check_same_desc(sa,ma);
+
+  D *d = ma[0]->d;
+  int nv = d->nv;
+  ord_t hi = 0;
   for (int i = 0; i < sa; ++i)
-    if (ma[i]->hi > highest) highest = ma[i]->hi;
+    if (ma[i]->hi > hi) hi = ma[i]->hi;
 
-  if (highest >= 6)
-    compose_parallel(sa,ma,mb,mc);
-  else
-  #endif // _OPENMP
+  int nc = d->ord2idx[hi+1], nb = (np + eval_blksz-1) / eval_blksz;
+  mad_alloc_tmp(idx_t, fa, nc);
+  mad_alloc_tmp(idx_t, fv, nc);
+  eval_fathers(d, hi, fa, fv);
 
-  compose_serial(sa,ma,mb,mc);
+  #ifdef _OPENMP
+  #pragma omp parallel if (nb > 1 && (long)np*nc >= eval_par_min)
+  #endif
+  {
+    NUM *pw = mad_malloc(nc * eval_blksz * sizeof *pw);
+
+    #ifdef _OPENMP
+    #pragma omp for schedule(static)
+    #endif
+    for (int b = 0; b < nb; ++b) {
+      int k = b*eval_blksz;
+      eval_blk(sa, ma, hi, MIN(eval_blksz, np-k), x+k*nv, r+k*sa, pw, fa, fv);
+    }
+
+    mad_free(pw);
+  }
+
+  mad_free_tmp(fa);
+  mad_free_tmp(fv);
+}
+
+void
+FUN(eval) (int sa, const T *ma[], int sb, const NUM tb[], int sc, NUM tc[])
+{
+  assert(ma && tb && tc);
+  ensure(sa && sb && sc);
+  ensure(sa == sc);
+  ensure(sb == ma[0]->d->nv);
+  FUN(map_eval)(sa, ma, 1, tb, tc);
+}
+
+void
+FUN(debug_mt) (int sa, const T *ma[], int nr, T *mc[])
+{
+  // mc[k*sa+i] = (exp(ma) o ma)[i] for the nr runs k spread over the threads,
+  // i.e. concurrent use of the temps and the tables of the descriptor of ma
+  ensure(nr > 0);
+  for (int k = 0; k < nr; ++k)
+    check_compose(sa, ma, sa, ma, sa, mc+k*sa);
+
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic,1)
+  #endif
+  for (int k = 0; k < nr; ++k) {
+    T *ta[sa];
+    for (int i = 0; i < sa; ++i) {
+      ta[i] = FUN(new)(ma[i], mad_tpsa_same);
+      FUN(exp)(ma[i], ta[i]);
+    }
+    FUN(compose)(sa, (const T**)ta, sa, ma, sa, mc+k*sa);
+    for (int i = 0; i < sa; ++i) FUN(del)(ta[i]);
+  }
 }
@@ -39,30 +39,32 @@
 static inline void
 fixed_point_iteration(const T *a, T *c, int iter, NUM expansion_coef[iter+1])
 {
+  // Horner scheme: c = coef[0] + p*(coef[1] + p*(... + p*coef[iter])), p = a-a0
+  // level k is only needed up to order iter-k as p has no order 0, and each
+  // level accumulates its product directly into the next one (fused mulacc)
   assert(a && c && expansion_coef);
   assert(iter >= 1); // ord 0 treated outside
 
-  T *acp = a->d->PFX(t[2]);
-  if (iter >=2)      // save copy before scale, to deal with aliasing
-    FUN(copy)(a,acp);
-
-  // iter 1
-  FUN(scl)(a, expansion_coef[1], c);
-  FUN(set0)(c, 0, expansion_coef[0]);
-
-  // iter 2..iter
-  if (iter >= 2) {
-    T *pow = a->d->PFX(t[1]),
-      *tmp = a->d->PFX(t[3]), *t;
-    FUN(set0)(acp, 0,0);
-    FUN(copy)(acp,pow);  // already did ord 1
-
-    for (int i = 2; i <= iter; ++i) {
-      FUN(mul)(acp,pow,tmp);
-      FUN(acc)(tmp,expansion_coef[i],c);
-      SWAP(pow,tmp,t);
-    }
+  struct desc_tmp *dt = mad_desc_tmp(a->d);
+  T *p = dt->PFX(t[2]), *r = dt->PFX(t[1]), *s = dt->PFX(t[3]), *t;
+  FUN(copy)(a,p);    // copy to deal with aliasing
+  FUN(set0)(p, 0,0);
+
+  // levels are truncated through the mo of the (per thread) temps, d->trunc
+  // is shared by all threads
+  ord_t mo = r->mo;
+  FUN(scalar)(r, expansion_coef[iter]);
+  for (int k = iter-1; k >= 1; --k) {
+    s->mo = iter-k;
+    FUN(scalar)(s, expansion_coef[k]);
+    FUN(mulacc)(p, r, 1, s);
+    SWAP(r,s,t);
   }
+  r->mo = s->mo = mo;
+
+  // level 0 in c
+  FUN(scalar)(c, expansion_coef[0]);
+  FUN(mulacc)(p, r, 1, c);
 }
 
 static inline void
@@ -72,7 +74,8 @@ sincos_fixed_point(const T *a, T *s, T *c, int iter_s, NUM sin_coef[iter_s+1], i
   assert(iter_s >= 1 && iter_c >= 1);  // ord 0 treated outside
 
   int max_iter = MAX(iter_s,iter_c);
-  T *acp = a->d->PFX(t[2]);
+  struct desc_tmp *dt = mad_desc_tmp(a->d);
+  T *acp = dt->PFX(t[2]);
   if (max_iter >= 2)      // save copy before scale, to deal with aliasing
     FUN(copy)(a,acp);
 
@@ -81,12 +84,12 @@ sincos_fixed_point(const T *a, T *s, T *c, int iter_s, NUM sin_coef[iter_s+1], i
   FUN(scl)(a,cos_coef[1],c); FUN(set0)(c, 0,cos_coef[0]);
 
   if (max_iter >= 2) {
-    T *pow = a->d->PFX(t[1]),
-      *tmp = a->d->PFX(t[3]), *t;
+    T *pow = dt->PFX(t[1]),
+      *tmp = dt->PFX(t[3]), *t;
     FUN(set0)(acp, 0,0);
     FUN(copy)(acp,pow);
 
-    for (int i = 1; i <= max_iter; ++i) {
+    for (int i = 2; i <= max_iter; ++i) {
       FUN(mul)(acp,pow,tmp);
 
       if (i <= iter_s) FUN(acc)(tmp,sin_coef[i],s);
@@ -334,7 +337,7 @@ FUN(sincosh) (const T *a, T *sh, T *ch)
     if (!sto) FUN(scalar)(sh, s_a0);
     else      FUN(sinh)(a,sh);
     if (!cto) FUN(scalar)(ch, c_a0);
-    else      FUN(cos)(a,ch);
+    else      FUN(cosh)(a,ch);
     return;
   }
 
@@ -426,7 +429,7 @@ FUN(tan) (const T *a, T *c)
   if (to > 5) {
     FUN(cos)(a,c);
     FUN(inv)(c,1,c);
-    T *tmp = c->d->PFX(t[4]);
+    T *tmp = mad_desc_tmp(c->d)->PFX(t[4]);
     FUN(sin)(a,tmp);
     FUN(mul)(tmp,c,c);  // 1 copy
     return;
@@ -459,7 +462,7 @@ FUN(cot) (const T *a, T *c)
   if (to > 5) {
     FUN(sin)(a,c);
     FUN(inv)(c,1,c);
-    T *tmp = c->d->PFX(t[4]);
+    T *tmp = mad_desc_tmp(c->d)->PFX(t[4]);
     FUN(cos)(a,tmp);
     FUN(mul)(tmp,c,c);  // 1 copy
     return;
@@ -167,6 +167,143 @@ split_and_inv(const D *d, const T *ma[], T *lin_inv[], T *nonlin[])
   mad_free_tmp(mat_knbi);
 }
 
+static inline void
+cut_lo(T *t, ord_t o)
+{
+  // remove the orders below o
+  if (o > t->hi) { FUN(clear)(t); return; }
+  for (ord_t i = t->lo; i < o; ++i)
+    t->nz = mad_bit_clr(t->nz,i);
+  t->coef[0] = 0;
+  if (t->lo < o) t->lo = o;
+}
+
+static inline void
+lin_apply(int sa, const NUM *li, T *x[], T *r[])
+{
+  // r = li * x, li is the inverse of the linear part
+  for (int i = 0; i < sa; ++i) {
+    FUN(clear)(r[i]);
+    for (int j = 0; j < sa; ++j)
+      FUN(acc)(x[j], li[i*sa+j], r[i]);
+  }
+}
+
+static inline void
+compose_trunc(int sa, T *ma[], int sb, T *mb[], T *mc[], ord_t to)
+{
+  // mc = ma o mb truncated at order to, the descriptor is left unchanged
+  for (int i = 0; i < sa; ++i)
+    FUN(clear)(mc[i]);
+  FUN(compose_ord)(sa, (const T**)ma, sb, (const T**)mb, sa, mc, 0, to);
+}
+
+static void
+minv_fixpt(int sa, T *lin_inv[], T *nonlin[], T *mc[], ord_t to)
+{
+  // iteratively compute higher orders of the inverse up to order to
+  // MC (OF ORDER I) = AL^-1 o [ I - ANL (NONLINEAR) o MC (OF ORDER I-1) ]
+  D *d = mc[0]->d;
+  T *tmp[sa];
+  for (int i = 0; i < sa; ++i) {
+    tmp[i] = FUN(newd)(d, mad_tpsa_default);
+    FUN(copy)(lin_inv[i], mc[i]);
+  }
+
+  for (int o = 2; o <= to; ++o) {
+    compose_trunc(sa, nonlin, sa, mc, tmp, o);
+
+    for (int v = 0; v < sa; ++v)
+      FUN(seti)(tmp[v], v+1, 1.0,1.0);    // add I
+
+    compose_trunc(sa, lin_inv, sa, tmp, mc, o);
+  }
+
+  for (int i = 0; i < sa; ++i)
+    FUN(del)(tmp[i]);
+}
+
+static void
+minv_newton(int sa, T *lin_inv[], T *nonlin[], T *mc[], ord_t to)
+{
+  // Newton iteration on MC = F(MC) = AL^-1 o [ I + NL o MC ], NL = -ANL
+  // from MC exact up to order k, DL = F(MC) - MC of orders ]k,K], K = 2k+1,
+  // MC += DL + AL^-1 (DNL o MC) DL with DNL o MC needed up to order K-k-1 only,
+  // solved order by order. Only one composition up to order K per iteration.
+  D *d = mc[0]->d;
+  int ns = sa*sa;
+  NUM li[ns];
+  T *t[sa], *g[sa], *dl[sa], *dn[ns], *jj[ns];
+
+  for (int i = 0; i < sa; ++i) {
+    for (int j = 0; j < sa; ++j)
+      li[i*sa+j] = FUN(geti)(lin_inv[i], j+1);
+    t  [i] = FUN(newd)(d, mad_tpsa_default);
+    g  [i] = FUN(newd)(d, mad_tpsa_default);
+    dl [i] = FUN(newd)(d, mad_tpsa_default);
+    FUN(copy)(lin_inv[i], mc[i]);
+  }
+
+  // jacobian of NL
+  for (int i = 0; i < sa; ++i)
+    for (int j = 0; j < sa; ++j) {
+      dn[i*sa+j] = FUN(newd)(d, mad_tpsa_default);
+      jj[i*sa+j] = FUN(newd)(d, mad_tpsa_default);
+      FUN(der)(nonlin[i], dn[i*sa+j], j+1);
+    }
+
+  // orders reached by the iterations, down from to, K is reached from K/2
+  ord_t ko[to+1];
+  int n = 0;
+  for (ord_t o = to; o > 1; o /= 2) ko[n++] = o;
+
+  for (ord_t k = 1; n > 0; k = ko[n]) {
+    ord_t K = ko[--n];
+
+    // DL = F(MC) - MC, orders ]k,K]
+    compose_trunc(sa, nonlin, sa, mc, t, K);
+    for (int i = 0; i < sa; ++i)
+      FUN(seti)(t[i], i+1, 1.0,1.0);    // add I
+    lin_apply(sa, li, t, g);
+    for (int i = 0; i < sa; ++i) {
+      FUN(sub)(g[i], mc[i], dl[i]);
+      cut_lo(dl[i], k+1);
+    }
+
+    // DL += AL^-1 (DNL o MC) DL, order s from the orders of DL below s
+    if (K > k+1) {
+      compose_trunc(ns, dn, sa, mc, jj, K-k-1);
+      for (int s = k+2; s <= K; ++s) {
+        for (int i = 0; i < sa; ++i) {
+          FUN(clear)(t[i]);
+          for (int j = 0; j < sa; ++j) {
+            FUN(clear)(g[0]);
+            FUN(mul_ord)(jj[i*sa+j], dl[j], g[0], s, s);
+            FUN(acc)(g[0], 1, t[i]);
+          }
+        }
+        lin_apply(sa, li, t, g);
+        for (int i = 0; i < sa; ++i)
+          FUN(acc)(g[i], 1, dl[i]);
+      }
+    }
+
+    for (int i = 0; i < sa; ++i)
+      FUN(acc)(dl[i], 1, mc[i]);
+  }
+
+  // cleanup
+  for (int i = 0; i < ns; ++i) {
+    FUN(del)(dn[i]);
+    FUN(del)(jj[i]);
+  }
+  for (int i = 0; i < sa; ++i) {
+    FUN(del)(t[i]);
+    FUN(del)(g[i]);
+    FUN(del)(dl[i]);
+  }
+}
+
 // --- PUBLIC FUNCTIONS -------------------------------------------------------
 
 void
@@ -178,36 +315,24 @@ FUN(minv) (int sa, const T *ma[sa], int sc, T *mc[sc])
     ensure(mad_bit_get(ma[i]->nz,1));
 
   D *d = ma[0]->d;
-  T *lin_inv[sa], *nonlin[sa], *tmp[sa];
+  T *lin_inv[sa], *nonlin[sa];
   for (int i = 0; i < sa; ++i) {
     lin_inv[i] = FUN(newd)(d,1);
     nonlin[i]  = FUN(new)(ma[i], mad_tpsa_same);
-    tmp[i]     = FUN(new)(ma[i], mad_tpsa_same);
   }
 
   split_and_inv(d, ma, lin_inv, nonlin);
 
-  // iteratively compute higher orders of the inverse
-  // MC (OF ORDER I) = AL^-1 o [ I - ANL (NONLINEAR) o MC (OF ORDER I-1) ]
-
-  for (int i = 0; i < sa; ++i)
-    FUN(copy)(lin_inv[i], mc[i]);
-
-  for (int o = 2; o <= d->mo; ++o) {
-    d->trunc = o;
-    FUN(compose)(sa, (const T**)nonlin,  sa, (const T**)mc,  sa, tmp);
-
-    for (int v = 0; v < sa; ++v)
-      FUN(seti)(tmp[v], v+1, 1.0,1.0);    // add I
-
-    FUN(compose)(sa, (const T**)lin_inv, sa, (const T**)tmp, sa, mc);
-  }
+  // up to the truncation order, knobs are not part of the jacobian
+  if (mad_tpsa_newton && d->nmv == d->nv)
+    minv_newton(sa, lin_inv, nonlin, mc, d->trunc);
+  else
+    minv_fixpt (sa, lin_inv, nonlin, mc, d->trunc);
 
   // cleanup
   for (int i = 0; i < sa; ++i) {
     FUN(del)(lin_inv[i]);
     FUN(del)(nonlin[i]);
-    FUN(del)(tmp[i]);
   }
 }
 
@@ -20,6 +20,7 @@
 #include <math.h>
 #include <assert.h>
 
+#include "mad_mem.h"
 #include "mad_log.h"
 #include "mad_desc_impl.h"
 
@@ -31,130 +32,256 @@
 
 // --- LOCAL FUNCTIONS --------------------------------------------------------
 
+// --- sparse multiplication: index lists of non-zero coefficients by order
+//     l[pi[o]..pi[o]+k[o]) are the sorted indexes (relative to pi[o]) of the
+//     non-zero coefficients of order o, built by FUN(mul) for the operands,
+//     used for the inner loop when nnz*mad_tpsa_sparse < n.
+
 static inline void
-hpoly_triang_mul(const NUM *ca, const NUM *cb, NUM *cc, int nb,
-                 const idx_t l[], const int *idx[])
-{
-  // asymm: c[2 2] = a[2 0]*b[0 2] + a[0 2]*b[2 0]
-  for (idx_t ib = 0; ib < nb; ib++)
-    if (cb[ib] || ca[ib])
-      for (idx_t ia = idx[0][ib]; ia < idx[1][ib]; ia++) {
-        int ic = l[hpoly_idx(ib,ia,nb)];
-        if (ic >= 0)
-          cc[ic] = cc[ic] + ca[ia]*cb[ib] + (ia == ib ? 0 : ca[ib]*cb[ia]);
-      }
+hpoly_nzidx(const T *a, idx_t l[], idx_t k[], ord_t hi)
+{
+  const D *d = a->d;
+  const idx_t *pi = d->ord2idx;
+
+  for (int o = 0; o <= d->mo; ++o) {
+    k[o] = 0;
+    if (!o || o > MIN(a->hi,hi) || !mad_bit_get(a->nz,o)) continue;
+    const NUM *ca = a->coef + pi[o];
+    idx_t *lo = l + pi[o], n = pi[o+1] - pi[o];
+    for (idx_t i = 0; i < n; ++i)
+      if (ca[i]) lo[k[o]++] = i;
+  }
+}
+
+static inline int
+hpoly_issp(idx_t k, idx_t n)
+{
+  return mad_tpsa_sparse && k*mad_tpsa_sparse < n;
+}
+
+static inline int
+hpoly_nzfst(const idx_t l[], int n, idx_t i)
+{
+  // first position in l[0..n) with l[pos] >= i
+  int pos = 0;
+  while (n > 0) {
+    int h = n/2;
+    if (l[pos+h] < i) pos += h+1, n -= h+1;
+    else              n  = h;
+  }
+  return pos;
+}
+
+// --- kernels by width of ic in L and Ls, uint16_t if d->i16 (nc < 65536)
+
+#define KFUN(name) MKNAME(name,16)
+#define IC_T uint16_t
+#include "mad_tpsa_mul.tc"
+#undef  KFUN
+#undef  IC_T
+
+#define KFUN(name) MKNAME(name,32)
+#define IC_T idx_t
+#include "mad_tpsa_mul.tc"
+#undef  KFUN
+#undef  IC_T
+
+static inline void
+hpoly_triang_mul(const NUM *ca, const NUM *cb, NUM *cc, NUM v, int nb,
+                 const idx_t ls[], const int h[], int i16)
+{
+  if (i16) hpoly_triang_mul16(ca,cb,cc,v,nb,ls,h);
+  else     hpoly_triang_mul32(ca,cb,cc,v,nb,ls,h);
 }
 
 static inline void
 hpoly_sym_mul(const NUM *ca1, const NUM *cb1, const NUM *ca2, const NUM *cb2,
-              NUM *cc, int na, int nb, const idx_t l[], const int *idx[])
-{
-  // na > nb so longer loop is inside
-  for (idx_t ib=0; ib < nb; ib++)
-    if (cb1[ib] || ca2[ib])
-      for (idx_t ia=idx[0][ib]; ia < idx[1][ib]; ia++) {
-        int ic = l[hpoly_idx(ib, ia, na)];
-        if (ic >= 0)
-          cc[ic] = cc[ic] + ca1[ia]*cb1[ib] + ca2[ib]*cb2[ia];
-      }
+              NUM *cc, NUM v, int nb, const idx_t ls[], const int h[], int i16)
+{
+  if (i16) hpoly_sym_mul16(ca1,cb1,ca2,cb2,cc,v,nb,ls,h);
+  else     hpoly_sym_mul32(ca1,cb1,ca2,cb2,cc,v,nb,ls,h);
 }
 
 static inline void
-hpoly_asym_mul(const NUM *ca, const NUM *cb, NUM *cc, int na, int nb,
-               const idx_t l[], const int *idx[])
-{
-  // oa > ob so longer loop is inside
-  for (idx_t ib=0; ib < nb; ib++)
-    if (cb[ib])
-      for (idx_t ia=idx[0][ib]; ia < idx[1][ib]; ia++) {
-        int ic = l[hpoly_idx(ib,ia,na)];
-        if (ic >= 0)
-          cc[ic] = cc[ic] + ca[ia]*cb[ib];
-      }
+hpoly_asym_mul(const NUM *ca, const NUM *cb, NUM *cc, NUM v, int nb,
+               const idx_t ls[], const int h[], int i16)
+{
+  if (i16) hpoly_asym_mul16(ca,cb,cc,v,nb,ls,h);
+  else     hpoly_asym_mul32(ca,cb,cc,v,nb,ls,h);
+}
+
+static inline void
+hpoly_asym_mul_sp(const NUM *ca, const NUM *cb, NUM *cc, NUM v, int na,
+                  const idx_t la[], int ka, const idx_t lb[], int kb,
+                  const void *l, const int *idx[], int strict, int i16)
+{
+  if (i16) hpoly_asym_mul_sp16(ca,cb,cc,v,na,la,ka,lb,kb,l,idx,strict);
+  else     hpoly_asym_mul_sp32(ca,cb,cc,v,na,la,ka,lb,kb,l,idx,strict);
 }
 
 static inline void
-hpoly_mul(const T *a, const T *b, T *c, const ord_t *ocs, bit_t *cnz, int in_parallel)
+hpoly_mul(const T *a, const T *b, T *c, NUM v, ord_t oc, int idx0, int idx1, bit_t *cnz,
+          const idx_t la[], const idx_t ka[], const idx_t lb[], const idx_t kb[])
 {
+  // c[oc] += v*(a*b)[oc] for the parts [idx0,idx1) of the coefs of order oc
   D *d = c->d;
-  int *pi = d->ord2idx, hod = d->mo/2;
+  int *pi = d->ord2idx, hod = d->mo/2, i16 = d->i16;
   const NUM *ca = a->coef,  *cb = b->coef;
         NUM *cc = c->coef;
         bit_t nza = a->nz  ,  nzb = b->nz;
-
-  for (int i = 0; ocs[i]; ++i) {
-    if (ocs[i] < c->lo || ocs[i] > c->hi + 1 || (ocs[i] == c->hi + 1 && !in_parallel))
-      continue;
-
-    ord_t oc = ocs[i];
-    int idx0 = 0, idx1 = 2;
-    if (in_parallel && ocs[i] >= c->hi) {
-      oc = c->hi;
-      if (ocs[i] == c->hi) idx1 = 1;
-      else                 idx0 = 1;
+  const int h[2] = { idx0, idx1 };
+
+  for (int j=1; j <= (oc-1)/2; ++j) {
+    int oa = oc-j, ob = j;            // oa > ob >= 1
+    int na = pi[oa+1] - pi[oa];
+    int nb = pi[ob+1] - pi[ob];
+    const void  *lc = d->L [oa*hod + ob];
+    const idx_t *ls = d->Ls[oa*hod + ob];
+    assert(lc && ls);
+    const int *idx[2] = { d->L_idx[oa*hod + ob][idx0],
+                          d->L_idx[oa*hod + ob][idx1]};
+    assert(idx[0] && idx[1]);
+
+    // sparse kernels when the operand of the inner loop (order oa) is sparse
+    int spa = hpoly_issp(ka[oa],na), spb = hpoly_issp(kb[oa],na);
+
+    if (mad_bit_get(nza,oa) && mad_bit_get(nzb,ob) &&
+        mad_bit_get(nza,ob) && mad_bit_get(nzb,oa)) {
+      if (spa && spb) {
+        hpoly_asym_mul_sp(ca+pi[oa],cb+pi[ob],cc,v, na, la+pi[oa],ka[oa], lb+pi[ob],kb[ob], lc,idx,0,i16);
+        hpoly_asym_mul_sp(cb+pi[oa],ca+pi[ob],cc,v, na, lb+pi[oa],kb[oa], la+pi[ob],ka[ob], lc,idx,0,i16);
+      } else
+      hpoly_sym_mul(ca+pi[oa],cb+pi[ob], ca+pi[ob],cb+pi[oa], cc,v, nb, ls, h, i16);
+      *cnz = mad_bit_set(*cnz,oc);
     }
-
-    for (int j=1; j <= (oc-1)/2; ++j) {
-      int oa = oc-j, ob = j;            // oa > ob >= 1
-      int na = pi[oa+1] - pi[oa];
-      int nb = pi[ob+1] - pi[ob];
-      const idx_t *lc  = d->L[oa*hod + ob];
-      assert(lc);
-      const int *idx[2] = { d->L_idx[oa*hod + ob][idx0],
-                            d->L_idx[oa*hod + ob][idx1]};
-      assert(idx[0] && idx[1]);
-
-      if (mad_bit_get(nza,oa) && mad_bit_get(nzb,ob) &&
-          mad_bit_get(nza,ob) && mad_bit_get(nzb,oa)) {
-        hpoly_sym_mul(ca+pi[oa],cb+pi[ob], ca+pi[ob],cb+pi[oa], cc, na,nb, lc, idx);
-        *cnz = mad_bit_set(*cnz,oc);
-      }
-      else if (mad_bit_get(nza,oa) && mad_bit_get(nzb,ob)) {
-        hpoly_asym_mul(ca+pi[oa],cb+pi[ob],cc, na,nb, lc, idx);
-        *cnz = mad_bit_set(*cnz,oc);
-      }
-      else if (mad_bit_get(nza,ob) && mad_bit_get(nzb,oa)) {
-        hpoly_asym_mul(cb+pi[oa],ca+pi[ob],cc, na,nb, lc, idx);
-        *cnz = mad_bit_set(*cnz,oc);
-      }
+    else if (mad_bit_get(nza,oa) && mad_bit_get(nzb,ob)) {
+      if (spa)
+        hpoly_asym_mul_sp(ca+pi[oa],cb+pi[ob],cc,v, na, la+pi[oa],ka[oa], lb+pi[ob],kb[ob], lc,idx,0,i16);
+      else
+      hpoly_asym_mul(ca+pi[oa],cb+pi[ob],cc,v, nb, ls, h, i16);
+      *cnz = mad_bit_set(*cnz,oc);
+    }
+    else if (mad_bit_get(nza,ob) && mad_bit_get(nzb,oa)) {
+      if (spb)
+        hpoly_asym_mul_sp(cb+pi[oa],ca+pi[ob],cc,v, na, lb+pi[oa],kb[oa], la+pi[ob],ka[ob], lc,idx,0,i16);
+      else
+      hpoly_asym_mul(cb+pi[oa],ca+pi[ob],cc,v, nb, ls, h, i16);
+      *cnz = mad_bit_set(*cnz,oc);
     }
+  }
 
-    if (! (oc & 1)) {  // even oc, triang matrix
-      int hoc = oc/2, nb = pi[hoc+1]-pi[hoc];
-      const idx_t *lc = d->L[hoc*hod + hoc];
-      const int *idx[2] = { d->L_idx[hoc*hod + hoc][idx0],
-                            d->L_idx[hoc*hod + hoc][idx1] };
-      assert(lc);
-      if (mad_bit_get(nza,hoc) && mad_bit_get(nzb,hoc) ) {
-        hpoly_triang_mul(ca+pi[hoc],cb+pi[hoc],cc, nb, lc, idx);
-        *cnz = mad_bit_set(*cnz,oc);
-      }
+  if (! (oc & 1)) {  // even oc, triang matrix
+    int hoc = oc/2, nb = pi[hoc+1]-pi[hoc];
+    const void  *lc = d->L [hoc*hod + hoc];
+    const idx_t *ls = d->Ls[hoc*hod + hoc];
+    const int *idx[2] = { d->L_idx[hoc*hod + hoc][idx0],
+                          d->L_idx[hoc*hod + hoc][idx1] };
+    assert(lc && ls);
+    if (mad_bit_get(nza,hoc) && mad_bit_get(nzb,hoc) ) {
+      if (hpoly_issp(ka[hoc],nb) && hpoly_issp(kb[hoc],nb)) {
+        hpoly_asym_mul_sp(ca+pi[hoc],cb+pi[hoc],cc,v, nb, la+pi[hoc],ka[hoc], lb+pi[hoc],kb[hoc], lc,idx,0,i16);
+        hpoly_asym_mul_sp(cb+pi[hoc],ca+pi[hoc],cc,v, nb, lb+pi[hoc],kb[hoc], la+pi[hoc],ka[hoc], lc,idx,1,i16);
+      } else
+      hpoly_triang_mul(ca+pi[hoc],cb+pi[hoc],cc,v, nb, ls, h, i16);
+      *cnz = mad_bit_set(*cnz,oc);
     }
   }
 }
 
 #ifdef _OPENMP
 static inline void
-hpoly_mul_par(const T *a, const T *b, T *c)
+hpoly_mul_par(const T *a, const T *b, T *c, NUM v, ord_t lo, ord_t hi,
+              const idx_t la[], const idx_t ka[], const idx_t lb[], const idx_t kb[])
 {
-  int nb_threads = omp_get_num_procs();
-  bit_t c_nzs[nb_threads];
-  for (int t = 0; t < nb_threads; ++t)
-    c_nzs[t] = c->nz;
+  // tasks (order, part) write disjoint coefs, highest orders first
+  const int np = desc_nparts, nt = (hi-lo+1) * np;
+  bit_t nz = c->nz;
 
-  #pragma omp parallel for
-  for (int t = 0; t < nb_threads; ++t)
-    hpoly_mul(a,b,c,c->d->ocs[t],&c_nzs[t],1);
+  #pragma omp parallel for schedule(dynamic,1) reduction(|:nz)
+  for (int t = 0; t < nt; ++t)
+    hpoly_mul(a,b,c,v, hi - t/np, t%np, t%np+1, &nz, la,ka,lb,kb);
 
-  for (int t = 0; t < nb_threads; ++t)
-    c->nz |= c_nzs[t];
+  c->nz = nz;
 }
 #endif
 
 static inline void
-hpoly_mul_ser(const T *a, const T *b, T *c)
+hpoly_mul_ser(const T *a, const T *b, T *c, NUM v, ord_t lo, ord_t hi,
+              const idx_t la[], const idx_t ka[], const idx_t lb[], const idx_t kb[])
+{
+  for (int oc = lo; oc <= hi; ++oc)
+    hpoly_mul(a,b,c,v, oc, 0, desc_nparts, &c->nz, la,ka,lb,kb);
+}
+
+static inline void
+hpoly_mul_run(const T *a, const T *b, T *c, NUM v, ord_t lo, ord_t hi)
+{
+  // c[lo..hi] += v*(a*b)[lo..hi] for orders 2+, c must span [lo,hi]
+  D *d = c->d;
+  lo = MAX(lo,2);
+  if (lo > hi) return;
+  mad_desc_needL(d, hi);
+  idx_t ka[d->mo+1], kb[d->mo+1];
+  mad_alloc_tmp(idx_t, la, d->nc);
+  mad_alloc_tmp(idx_t, lb, d->nc);
+  if (mad_tpsa_sparse) {
+    hpoly_nzidx(a, la, ka, hi-1);  // operand orders of c[hi]
+    hpoly_nzidx(b, lb, kb, hi-1);
+  }
+
+  #ifdef _OPENMP
+  if (hi >= d->mpo && !omp_in_parallel())
+    hpoly_mul_par(a,b,c,v, lo,hi, la,ka,lb,kb);
+  else
+  #endif
+    hpoly_mul_ser(a,b,c,v, lo,hi, la,ka,lb,kb);
+
+  mad_free_tmp(la);
+  mad_free_tmp(lb);
+}
+
+static inline void
+mul_acc(const T *a, const T *b, NUM v, T *c, ord_t lo, ord_t hi)
 {
-  hpoly_mul(a,b,c,c->d->ocs[0],&c->nz,0);
+  // c[lo..hi] += v*(a*b)[lo..hi], no aliasing
+  D *d = c->d;
+  lo = MAX(lo, a->lo + b->lo);
+  hi = MIN3(hi, a->hi + b->hi, MIN(c->mo, d->trunc));
+  if (lo > hi) return;
+
+  // extend c to the orders of a*b, like acc
+  const idx_t *pi = d->ord2idx;
+  const NUM *ca = a->coef, *cb = b->coef;
+        NUM *cc = c->coef;
+  ord_t c_lo = lo, c_hi = hi;
+  if (c->lo <= c->hi) {
+    c_lo = MIN(lo,c->lo), c_hi = MAX(hi,c->hi);
+    for (int i = pi[c_lo   ]; i < pi[c->lo]; ++i) cc[i] = 0;
+    for (int i = pi[c->hi+1]; i < pi[hi+1]; ++i) cc[i] = 0;
+  } else
+    for (int i = pi[MAX(lo,1)]; i < pi[hi+1]; ++i) cc[i] = 0;
+
+  // order 0 and linear parts a0*b + b0*a
+  NUM a0 = ca[0], b0 = cb[0];
+  if (!lo && a0 && b0) {
+    cc[0] += v*a0*b0;
+    c->nz = mad_bit_set(c->nz,0);
+  }
+  if (b0) {
+    NUM vb0 = v*b0;
+    for (int i = pi[MAX3(a->lo,lo,1)]; i < pi[MIN(a->hi,hi)+1]; ++i) cc[i] += vb0*ca[i];
+    c->nz = mad_bit_add(c->nz, mad_bit_lcut(mad_bit_trunc(a->nz,hi), lo));
+  }
+  if (a0) {
+    NUM va0 = v*a0;
+    for (int i = pi[MAX3(b->lo,lo,1)]; i < pi[MIN(b->hi,hi)+1]; ++i) cc[i] += va0*cb[i];
+    c->nz = mad_bit_add(c->nz, mad_bit_lcut(mad_bit_trunc(b->nz,hi), lo));
+  }
+
+  // order 2+, products restricted to [lo,hi]
+  c->lo = c_lo, c->hi = c_hi;
+  hpoly_mul_run(a,b,c,v, lo,hi);
+  c->nz = mad_bit_trunc(c->nz, c->hi);
 }
 
 static inline int
@@ -178,11 +305,12 @@ static inline void
 hpoly_der_lt(const NUM ca[], NUM cc[], idx_t idx, ord_t oc, ord_t ord, bit_t *cnz, const D *d)
 {
   const ord_t ho = d->mo/2;
-  const idx_t *lc = d->L[ord*ho + oc], *pi = d->ord2idx;
+  const idx_t *pi = d->ord2idx;
+  const void  *lc = d->L[ord*ho + oc];
   int nc = pi[oc+1] - pi[oc], cols = pi[ord+1] - pi[ord];
   // idx = idx - pi[ord];
   for (int ic = 0; ic < nc; ++ic) {
-    idx_t ia = lc[hpoly_idx(ic,idx-pi[ord],cols)];
+    idx_t ia = mad_desc_lc(d, lc, hpoly_idx(ic,idx-pi[ord],cols));
     if (ia >= 0 && ca[ia]) {
       assert(pi[oc+ord] <= ia && ia < pi[oc+ord+1]);
       cc[ic] = ca[ia] * der_coef(ia,idx,ord,d);
@@ -195,11 +323,12 @@ static inline void
 hpoly_der_eq(const NUM ca[], NUM cc[], idx_t idx, ord_t oc, ord_t ord, bit_t *cnz, const D *d)
 {
   const ord_t ho = d->mo/2;
-  const idx_t *lc = d->L[ord*ho + oc], *pi = d->ord2idx;
+  const idx_t *pi = d->ord2idx;
+  const void  *lc = d->L[ord*ho + oc];
   int nc = pi[ord+1] - pi[ord];
   idx_t idx_shifted = idx - pi[ord];
   for (int ic = 0; ic < nc; ++ic) {
-    idx_t ia = lc[hpoly_idx(MAX(ic,idx_shifted),MIN(ic,idx_shifted),nc)];
+    idx_t ia = mad_desc_lc(d, lc, hpoly_idx(MAX(ic,idx_shifted),MIN(ic,idx_shifted),nc));
     if (ia >= 0 && ca[ia]) {
       assert(pi[oc+ord] <= ia && ia < pi[oc+ord+1]);
       cc[ic] = ca[ia] * der_coef(ia,idx,ord,d);
@@ -212,11 +341,12 @@ static inline void
 hpoly_der_gt(const NUM ca[], NUM cc[], idx_t idx, ord_t oc, ord_t ord, bit_t *cnz, const D *d)
 {
   const ord_t ho = d->mo/2;
-  const idx_t *lc = d->L[oc*ho + ord], *pi = d->ord2idx;
+  const idx_t *pi = d->ord2idx;
+  const void  *lc = d->L[oc*ho + ord];
   int nc = pi[oc+1] - pi[oc];
   idx_t idx_shifted = idx - pi[ord];
   for (int ic = 0; ic < nc; ++ic) {
-    idx_t ia = lc[hpoly_idx(idx_shifted,ic,nc)];
+    idx_t ia = mad_desc_lc(d, lc, hpoly_idx(idx_shifted,ic,nc));
     if (ia >= 0 && ca[ia]) {
       assert(pi[oc+ord] <= ia && ia < pi[oc+ord+1]);
       cc[ic] = ca[ia] * der_coef(ia,idx,ord,d);
@@ -234,6 +364,8 @@ hpoly_der(const T *a, idx_t idx, ord_t ord, T *c)
         NUM *cc;
 
   c->hi = MIN3(c->mo, d->trunc, a->hi-ord);  // initial guess, readjust based on nz
+  mad_desc_needL(d, a->hi);
+  for (int i = pi[1]; i < pi[c->hi+1]; ++i) c->coef[i] = 0;
   for (int oc = 1; oc <= c->hi; ++oc)
     if (mad_bit_get(a->nz,oc+ord)) {
       cc = c->coef + pi[oc];
@@ -377,6 +509,8 @@ FUN(der) (const T *a, T *c, int var)
 
   idx_t *pi = d->ord2idx;
   const NUM *ca = a->coef;
+  mad_desc_needL(d, a->hi);
+  for (int i = pi[1]; i < pi[c->hi+1]; ++i) c->coef[i] = 0;
 
   ord_t der_ord = 1, oc = 1;
   if (mad_bit_get(a->nz,oc+1))
@@ -544,7 +678,7 @@ FUN(mul) (const T *a, const T *b, T *r)
   assert(a && b && r);
   ensure(a->d == b->d && a->d == r->d);
 
-  T *c = (a == r || b == r) ? r->d->PFX(t[0]) : r;
+  T *c = (a == r || b == r) ? mad_desc_tmp(r->d)->PFX(t[0]) : r;
 
   D *d = a->d;
   c->lo = a->lo + b->lo;
@@ -576,6 +710,8 @@ FUN(mul) (const T *a, const T *b, T *r)
     for (int i = 1; i < max_ord1; ++i) c->coef[i] = a0*b->coef[i];
     c->nz = mad_bit_set(c->nz,1);
   }
+  else                       // no order 1 (c->lo may be 0 with a0 = b0 = 0)
+    for (int i = 1; i < max_ord1; ++i) c->coef[i] = 0;
 
   // order 2+
   if (c->hi >= 2) {
@@ -593,12 +729,7 @@ FUN(mul) (const T *a, const T *b, T *r)
     if (a0) c->nz = mad_bit_trunc(mad_bit_add(c->nz,b->nz),c->hi);
     if (b0) c->nz = mad_bit_trunc(mad_bit_add(c->nz,a->nz),c->hi);
 
-    #ifdef _OPENMP
-    if (c->hi >= 12)
-      hpoly_mul_par(a,b,c);
-    else
-    #endif
-      hpoly_mul_ser(a,b,c);
+    hpoly_mul_run(a,b,c,1, c->lo,c->hi);
   }
 
 ret:
@@ -606,6 +737,53 @@ ret:
   if (c != r) FUN(copy)(c,r);
 }
 
+void
+FUN(mulacc) (const T *a, const T *b, NUM v, T *c)
+{
+  assert(a && b && c);
+  ensure(a->d == b->d && a->d == c->d);
+  if (!v) return;
+
+  D *d = c->d;
+  if (a == c || b == c) {
+    struct desc_tmp *dt = mad_desc_tmp(d);
+    T *t = dt->PFX(t[0]) != a && dt->PFX(t[0]) != b ? dt->PFX(t[0]) : dt->PFX(t[4]);
+    FUN(mul)(a,b,t);
+    FUN(acc)(t,v,c);
+    return;
+  }
+
+  mul_acc(a,b,v,c, 0,c->mo);
+}
+
+void
+FUN(mul_ord) (const T *a, const T *b, T *c, ord_t lo, ord_t hi)
+{
+  // c[lo..hi] = (a*b)[lo..hi], other orders of c are left unchanged
+  assert(a && b && c);
+  ensure(a->d == b->d && a->d == c->d);
+
+  D *d = c->d;
+  hi = MIN3(hi, c->mo, d->trunc);
+  if (lo > hi) return;
+
+  if (a == c || b == c) { // the product may need the orders of c below lo
+    struct desc_tmp *dt = mad_desc_tmp(d);
+    T *t = dt->PFX(t[0]) != a && dt->PFX(t[0]) != b ? dt->PFX(t[0]) : dt->PFX(t[4]);
+    FUN(copy)(c,t);
+    if (a == c) a = t;
+    if (b == c) b = t;
+  }
+
+  // clear orders [lo,hi] of c
+  const idx_t *pi = d->ord2idx;
+  for (int i = pi[MAX(lo,c->lo)]; i < pi[MIN(hi,c->hi)+1]; ++i) c->coef[i] = 0;
+  if (!lo) c->coef[0] = 0;
+  c->nz &= ~mad_bit_lcut(mad_bit_trunc(c->nz, hi), lo);
+
+  mul_acc(a,b,1,c, lo,hi);
+}
+
 void
 FUN(div) (const T *a, const T *b, T *c)
 {
@@ -615,7 +793,7 @@ FUN(div) (const T *a, const T *b, T *c)
 
   if (b->hi == 0) { FUN(scl) (a,1/b->coef[0],c); return; }
 
-  T *tmp = c->d->PFX(t[4]);  // t1-t3 used in inv
+  T *tmp = mad_desc_tmp(c->d)->PFX(t[4]);  // t1-t3 used in inv
   FUN(inv) (b,1,tmp);
   FUN(mul) (a,tmp,c);
 }
@@ -630,7 +808,7 @@ FUN(ipow) (const T *a, T *c, int n)
 
   if (n < 0) { n = -n; inv = 1; }
 
-  T *t1 = c->d->PFX(t[1]);
+  T *t1 = mad_desc_tmp(c->d)->PFX(t[1]);
 
   switch (n) {
     case 0: FUN(scalar) (c, 1);    break; // ok: no copy
@@ -639,7 +817,7 @@ FUN(ipow) (const T *a, T *c, int n)
     case 3: FUN(mul   ) (a,a, t1); FUN(mul)(t1,a,  c); break; // ok: 1 copy if a==c
     case 4: FUN(mul   ) (a,a, t1); FUN(mul)(t1,t1, c); break; // ok: no copy
     default: {
-      T *t2 = c->d->PFX(t[2]);
+      T *t2 = mad_desc_tmp(c->d)->PFX(t[2]);
 
       FUN(copy  )(a, t1);
       FUN(scalar)(c, 1 );
@@ -691,7 +869,7 @@ FUN(axypb) (NUM a, const T *x, const T *y, NUM b, T *r)
   assert(x && y && r);
   ensure(x->d == y->d && y->d == r->d);
 
-  T *t1 = (x == r || y == r) ? r->d->PFX(t[1]) : r;
+  T *t1 = (x == r || y == r) ? mad_desc_tmp(r->d)->PFX(t[1]) : r;
   FUN(mul)(x,y, t1);
   FUN(axpb)(a,t1, b, r);
 }
@@ -702,7 +880,7 @@ FUN(axypbzpc) (NUM a, const T *x, const T *y, NUM b, const T *z, NUM c, T *r)
   assert(x && y && z && r);
   ensure(x->d == y->d && y->d == z->d && z->d == r->d);
 
-  T *t1 = (x == r || y == r || z == r) ? r->d->PFX(t[1]) : r;
+  T *t1 = (x == r || y == r || z == r) ? mad_desc_tmp(r->d)->PFX(t[1]) : r;
   FUN(mul)(x,y, t1);
   FUN(axpbypc)(a,t1, b,z, c, r);
 }
@@ -714,8 +892,8 @@ FUN(axypbvwpc) (NUM a, const T *x, const T *y,
   assert(x && y && v && w && r);
   ensure(x->d == y->d && y->d == v->d && v->d == w->d && w->d == r->d);
 
-  T *t1 = (x == r || y == r || v == r || w == r) ? r->d->PFX(t[1]) : r;
-  T *t2 = (v == r || w == r || t1 == r) ? r->d->PFX(t[2]) : r;
+  T *t1 = (x == r || y == r || v == r || w == r) ? mad_desc_tmp(r->d)->PFX(t[1]) : r;
+  T *t2 = (v == r || w == r || t1 == r) ? mad_desc_tmp(r->d)->PFX(t[2]) : r;
   FUN(mul)(x,y, t1);
   FUN(mul)(v,w, t2);
   FUN(axpbypc)(a,t1, b,t2, c, r);
@@ -727,41 +905,60 @@ FUN(ax2pby2pcz2) (NUM a, const T *x, NUM b, const T *y, NUM c, const T *z, T *r)
   assert(x && y && z && r);
   ensure(x->d == y->d && y->d == z->d && z->d == r->d);
 
-  T *t3 = (z == r) ? r->d->PFX(t[3]) : r;
+  T *t3 = (z == r) ? mad_desc_tmp(r->d)->PFX(t[3]) : r;
   FUN(axypbvwpc)(a,x,x, b,y,y, 0, t3);
   FUN(axypbzpc)(c,z,z, 1,t3, 0, r);
 }
 
-void
-FUN(poisson) (const T *a, const T *b, T *c, int n)
+static inline void
+poisson_run(const T *a, const T *b, T *c, int n, ord_t lo, ord_t hi)
 {
-  // C = [A,B] (POISSON BRACKET, 2*n: No of PHASEVARS
-  assert(a && b && c);
-  ensure(a->d == b->d && b->d == c->d);
-
-  T *is[4];
-  for (int i = 0; i < 4; ++i)
+  // c[lo..hi] = [a,b][lo..hi], c is cleared, no aliasing
+  T *is[2];
+  for (int i = 0; i < 2; ++i)
     is[i] = FUN(new)(a, a->d->trunc);
 
+  FUN(clear)(c);
   for (int i = 1; i <= n; ++i) {
     FUN(der)(a, is[0], 2*i - 1);
     FUN(der)(b, is[1], 2*i    );
-    FUN(mul)(is[0],is[1],is[2]);
-    FUN(add)(is[3],is[2],is[0]);
-    FUN(copy)(is[0],is[3]);      // TODO: use swap ?
+    mul_acc(is[0],is[1], 1,c, lo,hi);
 
     FUN(der)(a, is[0], 2*i    );
     FUN(der)(b, is[1], 2*i - 1);
-    FUN(mul)(is[0],is[1],is[2]);
-    FUN(sub)(is[3],is[2],is[0]);
-    FUN(copy)(is[0],is[3]);
+    mul_acc(is[0],is[1],-1,c, lo,hi);
   }
 
-  FUN(copy)(is[3], c);
-  for (int i = 0; i < 4; ++i)
+  for (int i = 0; i < 2; ++i)
     FUN(del)(is[i]);
 }
 
+void
+FUN(poisson) (const T *a, const T *b, T *c, int n)
+{
+  // C = [A,B] (POISSON BRACKET, 2*n: No of PHASEVARS
+  assert(a && b && c);
+  ensure(a->d == b->d && b->d == c->d);
+
+  T *r = FUN(new)(a, a->d->trunc);
+  poisson_run(a,b,r,n, 0,r->mo);
+  FUN(copy)(r, c);
+  FUN(del)(r);
+}
+
+void
+FUN(poisson_ord) (const T *a, const T *b, T *c, int n, ord_t lo, ord_t hi)
+{
+  // c[lo..hi] = [a,b][lo..hi], other orders of c are left unchanged
+  assert(a && b && c);
+  ensure(a->d == b->d && b->d == c->d);
+
+  T *r = FUN(new)(a, a->d->trunc);
+  poisson_run(a,b,r,n, lo,hi);
+  FUN(copy_ord)(r, c, lo,hi);
+  FUN(del)(r);
+}
+
 // --- WITHOUT COMPLEX-BY-VALUE VERSION ---------------------------------------
 
 #ifdef MAD_CTPSA_IMPL
@@ -778,6 +975,9 @@ void FUN(acc_r) (const T *a, num_t v_re, num_t v_im, T *c)
 void FUN(scl_r) (const T *a, num_t v_re, num_t v_im, T *c)
 { FUN(scl)(a, CNUM(v), c); }
 
+void FUN(mulacc_r) (const T *a, const T *b, num_t v_re, num_t v_im, T *c)
+{ FUN(mulacc)(a, b, CNUM(v), c); }
+
 void FUN(axpb_r) (num_t a_re, num_t a_im, const T *x,
                   num_t b_re, num_t b_im, T *r)
 { FUN(axpb)(CNUM(a), x, CNUM(b), r); }
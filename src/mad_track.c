@@ -1,6 +1,10 @@
+#include <math.h>
+#include <string.h>
 #include <assert.h>
 
+#include "mad_mem.h"
 #include "mad_tpsa.h"
+#include "mad_track.h"
 
 // TODO: update the maps with the final Lua versions!
 
@@ -20,6 +24,7 @@ mad_track_drift(T * restrict m[], num_t L, num_t B, num_t E)
   assert(x ); assert(y ); assert(s ); 
   assert(px); assert(py); assert(ps);
 
+  mad_arena_push(0); // temporaries
   T *t1 = mad_tpsa_new(x, mad_tpsa_default);
   T *t2 = mad_tpsa_new(s, mad_tpsa_same   );
 
@@ -38,6 +43,7 @@ mad_track_drift(T * restrict m[], num_t L, num_t B, num_t E)
 
   mad_tpsa_del(t2);
   mad_tpsa_del(t1);
+  mad_arena_pop();
 }
 
 void mad_track_kick(T * restrict m[], num_t L, num_t B, int n, num_t Bn[n], num_t An[n]);
@@ -56,6 +62,7 @@ mad_track_kick(T * restrict m[], num_t L, num_t B, int n, num_t Bn[n], num_t An[
 
   int dir = 1; // TODO: (m.dir or 1) * (m.charge or 1)
 
+  mad_arena_push(0); // temporaries
   T* bbxtw = mad_tpsa_new(px, mad_tpsa_same);
   T* bbytw = mad_tpsa_new(py, mad_tpsa_same);
 
@@ -83,5 +90,1027 @@ mad_track_kick(T * restrict m[], num_t L, num_t B, int n, num_t Bn[n], num_t An[
 
   mad_tpsa_del(bbytw);
   mad_tpsa_del(bbxtw);
+  mad_arena_pop();
 }
 
+// --- maps on tpsa (in place) ------------------------------------------------o
+
+// maps follow the Lua versions in madl_track.mad and the batched maps below,
+// the map m[0..5] = x,px,y,py,t,pt is updated in place and the intermediate
+// results are stored in the temporaries w[0..trk_ntmp-1] of mad_track_tmp_new
+
+// multipole coefficients knl[i]/i!, ksl[i]/i! scaled by lw
+static inline void
+mult_coef (int n, const num_t knl[n], const num_t ksl[n], num_t lw,
+                        num_t  kn [n],       num_t  ks [n])
+{
+  num_t f = 1;
+  for (int i=0; i < n; i++) {
+    if (i > 1) f *= i;
+    kn[i] = lw*knl[i]/f;
+    ks[i] = lw*ksl[i]/f;
+  }
+}
+
+#define CHKM assert(m && m[0] && m[1] && m[2] && m[3] && m[4] && m[5] && w)
+
+#define M_DECL \
+  T *x = m[0], *px = m[1], \
+    *y = m[2], *py = m[3], \
+    *t = m[4], *pt = m[5]
+
+T**
+mad_track_tmp_new (const T *ref)
+{
+  assert(ref);
+  T **w = mad_malloc(trk_ntmp * sizeof *w);
+  for (int i=0; i < trk_ntmp; i++)
+    w[i] = mad_tpsa_new(ref, mad_tpsa_default);
+  return w;
+}
+
+void
+mad_track_tmp_del (T *w[])
+{
+  if (!w) return;
+  for (int i=0; i < trk_ntmp; i++)
+    mad_tpsa_del(w[i]);
+  mad_free(w);
+}
+
+// r = 1 + 2*beta_inv*pt + pt^2 - a*px^2 - b*py^2
+static inline void
+tpsa_pt2 (T *m[6], num_t beta_inv, num_t a, num_t b, T *r)
+{
+  mad_tpsa_ax2pby2pcz2(1,m[5], -a,m[1], -b,m[3], r);
+  mad_tpsa_axpbypc(2*beta_inv,m[5], 1,r, 1, r);
+}
+
+// r = pt + beta_inv
+static inline void
+tpsa_tfac (T *m[6], num_t beta_inv, T *r)
+{
+  mad_tpsa_copy(m[5], r);
+  mad_tpsa_set0(r, 1,beta_inv);
+}
+
+// *by, *bx = Horner evaluation of the multipoles in x + iy, uses w[0..2]
+static void
+tpsa_mult (T *m[6], T *w[], int n, const num_t kn[n], const num_t ks[n],
+           T **by_, T **bx_)
+{
+  T *x = m[0], *y = m[2];
+  T *by = w[0], *bx = w[1], *byt = w[2], *tmp;
+
+  mad_tpsa_scalar(by, kn[n-1]);
+  mad_tpsa_scalar(bx, ks[n-1]);
+
+  for (int j=n-2; j >= 0; j--) {
+    mad_tpsa_axypbvwpc(1,x,by, -1,y,bx, kn[j], byt);
+    mad_tpsa_axypbvwpc(1,y,by,  1,x,bx, ks[j], bx );
+    tmp = by, by = byt, byt = tmp;
+  }
+  *by_ = by, *bx_ = bx;
+}
+
+void
+mad_track_tpsa_strait_drift (T *m[6], T *w[], num_t l, num_t beta_inv,
+                             num_t tpath)
+{
+  CHKM; M_DECL; (void)pt;
+  const num_t dt = (1-tpath)*l*beta_inv;
+  T *l_pz = w[0], *tf = w[1];
+
+  tpsa_pt2(m, beta_inv, 1, 1, l_pz);
+  mad_tpsa_invsqrt(l_pz, l, l_pz);              // l/pz
+  tpsa_tfac(m, beta_inv, tf);
+
+  mad_tpsa_axypbzpc( 1,px,l_pz, 1,x,  0, x);    // x + px*l_pz
+  mad_tpsa_axypbzpc( 1,py,l_pz, 1,y,  0, y);    // y + py*l_pz
+  mad_tpsa_axypbzpc(-1,tf,l_pz, 1,t, dt, t);    // t + dt - (beta_inv+pt)*l_pz
+}
+
+void
+mad_track_tpsa_curved_drift (T *m[6], T *w[], num_t l, num_t beta_inv,
+                             num_t tpath, num_t rho)
+{
+  CHKM; M_DECL; (void)pt;
+  const num_t angle = l/rho, dt = (1-tpath)*l*beta_inv;
+  const num_t sa = sin(angle), ca = cos(angle), ta = tan(angle);
+  const num_t sa2 = sin(angle/2), sa2_2 = 2*sa2*sa2;
+  T *pz = w[0], *pz_ = w[1], *ptt = w[2], *f = w[3], *tf = w[4], *xt = w[5];
+
+  tpsa_pt2(m, beta_inv, 1, 1, pz);
+  mad_tpsa_sqrt(pz, pz);
+  mad_tpsa_inv (pz, 1, pz_);
+  mad_tpsa_axypb(-ta,px,pz_, 1, ptt);           // 1 - ta*px/pz
+
+  mad_tpsa_axpb(1,x, rho, f);                   // (x+rho)*pz_/ptt
+  mad_tpsa_mul(f, pz_, f);
+  mad_tpsa_div(f, ptt, f);
+
+  mad_tpsa_axypbzpc(rho*sa,px,pz_, 1,x, rho*sa2_2, xt);
+  mad_tpsa_div(xt, ptt, xt);
+  mad_tpsa_scl(xt, 1/ca, x);                    // x + rho*(..) / (ca*ptt)
+
+  mad_tpsa_axpbypc(ca,px, sa,pz, 0, px);        // ca*px + sa*pz
+  mad_tpsa_axypbzpc(ta,f,py, 1,y, 0, y);        // y + ta*f*py
+
+  tpsa_tfac(m, beta_inv, tf);
+  mad_tpsa_mul(f, tf, tf);
+  mad_tpsa_axpbypc(-ta,tf, 1,t, dt, t);         // t + dt - ta*f*(beta_inv+pt)
+}
+
+void
+mad_track_tpsa_solenoid_drift (T *m[6], T *w[], num_t l, num_t beta_inv,
+                               num_t tpath, num_t bsol)
+{
+  if (bsol == 0) {
+    mad_track_tpsa_strait_drift(m, w, l, beta_inv, tpath); return;
+  }
+
+  CHKM; M_DECL;
+  const num_t bsol2 = bsol*bsol, dt = (1-tpath)*l*beta_inv;
+  T *xp = w[0], *yp = w[1], *l_pz = w[2], *ang = w[3];
+  T *sa = w[4], *ca = w[5], *tmp = w[6], *pyt = w[7];
+
+  mad_tpsa_axpbypc(1,px,  bsol,y, 0, xp);       // px + bsol*y
+  mad_tpsa_axpbypc(1,py, -bsol,x, 0, yp);       // py - bsol*x
+
+  mad_tpsa_ax2pby2pcz2(1,pt, -1,xp, -1,yp, l_pz);
+  mad_tpsa_axpbypc(2*beta_inv,pt, 1,l_pz, 1, l_pz);
+  mad_tpsa_invsqrt(l_pz, l, l_pz);              // l/pz
+  mad_tpsa_scl(l_pz, bsol, ang);
+
+  mad_tpsa_sincos(ang, sa, ca);
+  mad_tpsa_scl(sa, 1/bsol, tmp);                // l_pz*sinc(angle)
+
+  T *xt = xp, *pxt = yp, *yt = ang;
+  mad_tpsa_axypbvwpc(1,ca,x , 1     ,tmp,px, 0, xt );
+  mad_tpsa_axypbvwpc(1,ca,px, -bsol2,tmp,x , 0, pxt);
+  mad_tpsa_axypbvwpc(1,ca,y , 1     ,tmp,py, 0, yt );
+  mad_tpsa_axypbvwpc(1,ca,py, -bsol2,tmp,y , 0, pyt);
+
+  mad_tpsa_axypbvwpc(1,ca,xt , 1,sa,yt , 0, x );
+  mad_tpsa_axypbvwpc(1,ca,pxt, 1,sa,pyt, 0, px);
+  mad_tpsa_axypbvwpc(1,ca,yt ,-1,sa,xt , 0, y );
+  mad_tpsa_axypbvwpc(1,ca,pyt,-1,sa,pxt, 0, py);
+
+  tpsa_tfac(m, beta_inv, tmp);
+  mad_tpsa_axypbzpc(-1,tmp,l_pz, 1,t, dt, t);   // t + dt - (beta_inv+pt)*l_pz
+}
+
+void
+mad_track_tpsa_strait_kick (T *m[6], T *w[], num_t lw, num_t dirch,
+                            int n, const num_t knl[n], const num_t ksl[n])
+{
+  CHKM; M_DECL; (void)x; (void)y; (void)t; (void)pt;
+  if (n <= 0) return;
+
+  num_t kn[n], ks[n];
+  mult_coef(n, knl, ksl, lw, kn, ks);
+
+  T *by, *bx;
+  tpsa_mult(m, w, n, kn, ks, &by, &bx);
+  mad_tpsa_axpbypc(1,px, -dirch,by, 0, px);
+  mad_tpsa_axpbypc(1,py,  dirch,bx, 0, py);
+}
+
+void
+mad_track_tpsa_curved_kick (T *m[6], T *w[], num_t lw, num_t dirch, num_t k0,
+                            int n, const num_t knl[n], const num_t ksl[n])
+{
+  CHKM; M_DECL; (void)y; (void)t; (void)pt;
+  if (n <= 0) return;
+
+  num_t kn[n], ks[n];
+  mult_coef(n, knl, ksl, lw, kn, ks);
+
+  T *by, *bx;
+  tpsa_mult(m, w, n, kn, ks, &by, &bx);
+  mad_tpsa_axypbzpc(-dirch*k0,x,by, 1,px, 0, px); // px - dirch*by*(1+k0*x)
+  mad_tpsa_axpbypc (1,px, -dirch,by, 0, px);
+  mad_tpsa_axypbzpc( dirch*k0,x,bx, 1,py, 0, py); // py + dirch*bx*(1+k0*x)
+  mad_tpsa_axpbypc (1,py,  dirch,bx, 0, py);
+}
+
+void
+mad_track_tpsa_thin_kick (T *m[6], T *w[], num_t beta_inv, num_t dirch,
+                          num_t lrad, num_t knl1, num_t ksl1,
+                          int n, const num_t knl[n], const num_t ksl[n])
+{
+  CHKM; M_DECL; (void)pt;
+  if (n <= 0) return;
+
+  num_t kn[n], ks[n];
+  mult_coef(n, knl, ksl, 1, kn, ks);
+
+  // px += dirch*(knl1 - by), py += dirch*(bx - ksl1)
+  kn[0] -= knl1, ks[0] -= ksl1;
+
+  T *by, *bx;
+  tpsa_mult(m, w, n, kn, ks, &by, &bx);
+  mad_tpsa_axpbypc(1,px, -dirch,by, 0, px);
+  mad_tpsa_axpbypc(1,py,  dirch,bx, 0, py);
+
+  if (knl1 == 0 && ksl1 == 0) return;
+
+  T *pz = w[3], *tf = w[4], *dt = w[5];
+  tpsa_pt2(m, beta_inv, 0, 0, pz);
+  mad_tpsa_sqrt(pz, pz);
+
+  if (lrad != 0) { // dipole focusing and deltap
+    mad_tpsa_axpbypc(dirch*knl1,pz, 1,px, -dirch*knl1, px);
+    mad_tpsa_axpbypc(-knl1*knl1/lrad,x, 1,px, 0, px);
+    mad_tpsa_axpbypc(dirch*ksl1,pz, 1,py, -dirch*ksl1, py);
+    mad_tpsa_axpbypc(-ksl1*ksl1/lrad,y, 1,py, 0, py);
+  }
+
+  tpsa_tfac(m, beta_inv, tf);
+  mad_tpsa_axpbypc(knl1,x, -ksl1,y, 0, dt);
+  mad_tpsa_mul(dt, tf, dt);
+  mad_tpsa_div(dt, pz, dt);
+  mad_tpsa_axpbypc(1,t, -dirch,dt, 0, t);       // t - dirch*(..)*(beta_inv+pt)/pz
+}
+
+void
+mad_track_tpsa_srot (T *m[6], T *w[], num_t angle)
+{
+  CHKM; M_DECL; (void)t; (void)pt;
+  const num_t sa = sin(angle), ca = cos(angle);
+  T *xt = w[0], *pxt = w[1];
+
+  mad_tpsa_axpbypc(ca,x , sa,y , 0, xt );
+  mad_tpsa_axpbypc(ca,px, sa,py, 0, pxt);
+  mad_tpsa_axpbypc(ca,y , -sa,x , 0, y );
+  mad_tpsa_axpbypc(ca,py, -sa,px, 0, py);
+  mad_tpsa_copy(xt , x );
+  mad_tpsa_copy(pxt, px);
+}
+
+void
+mad_track_tpsa_yrot (T *m[6], T *w[], num_t angle, num_t beta_inv)
+{
+  CHKM; M_DECL; (void)pt;
+  const num_t sa = sin(angle), ca = cos(angle), ta = tan(angle);
+  T *pz = w[0], *pz_ = w[1], *ptt = w[2], *f = w[3], *tf = w[4];
+
+  tpsa_pt2(m, beta_inv, 1, 1, pz);
+  mad_tpsa_sqrt(pz, pz);
+  mad_tpsa_inv (pz, 1, pz_);
+  mad_tpsa_axypb(-ta,px,pz_, 1, ptt);           // 1 - ta*px/pz
+
+  mad_tpsa_mul(x, pz_, f);                      // x*pz_/ptt
+  mad_tpsa_div(f, ptt, f);
+
+  mad_tpsa_div(x, ptt, x);
+  mad_tpsa_scl(x, 1/ca, x);                     // x/(ca*ptt)
+  mad_tpsa_axpbypc(ca,px, sa,pz, 0, px);        // ca*px + sa*pz
+  mad_tpsa_axypbzpc(ta,f,py, 1,y, 0, y);        // y + ta*f*py
+
+  tpsa_tfac(m, beta_inv, tf);
+  mad_tpsa_axypbzpc(-ta,f,tf, 1,t, 0, t);       // t - ta*f*(beta_inv+pt)
+}
+
+void
+mad_track_tpsa_face (T *m[6], T *w[], num_t beta_inv, num_t dir, num_t k0,
+                     num_t h)
+{
+  CHKM; M_DECL;
+  const num_t kh = dir*k0*h/2;
+  T *ptt2 = w[0], *xi = w[1], *dxi_px = w[2], *dxi_ddel = w[3];
+  T *y2 = w[4], *tmp = w[5];
+
+  if (dir == 1) mad_tpsa_axypbzpc(kh,x,x, 1,px, 0, px); // reversal symmetry
+
+  tpsa_pt2(m, beta_inv, 1, 0, ptt2);
+  tpsa_pt2(m, beta_inv, 0, 0, xi);
+  mad_tpsa_sqrt(xi, xi);
+  mad_tpsa_div (xi, ptt2, xi);
+  mad_tpsa_scl (xi, dir*k0*h, xi);
+
+  mad_tpsa_mul(px, xi, dxi_px);                 //  2*px*xi/ptt2
+  mad_tpsa_div(dxi_px, ptt2, dxi_px);
+  mad_tpsa_scl(dxi_px, 2, dxi_px);
+
+  mad_tpsa_axpb(1,pt, 1, dxi_ddel);             // -2*xi*(1+pt)/ptt2
+  mad_tpsa_mul(dxi_ddel, xi, dxi_ddel);
+  mad_tpsa_div(dxi_ddel, ptt2, dxi_ddel);
+  mad_tpsa_scl(dxi_ddel, -2, dxi_ddel);
+
+  mad_tpsa_mul(y, y, y2);
+  mad_tpsa_axypb(-1,dxi_px,y2, 1, tmp);
+  mad_tpsa_div(x, tmp, x);                      // x/(1-dxi_px*y^2)
+  mad_tpsa_axypbzpc(-1,xi,y2, 1,px, 0, px);     // px - xi*y^2
+
+  mad_tpsa_mul(x, y, tmp);
+  mad_tpsa_axypbzpc(-2,xi,tmp, 1,py, 0, py);    // py - 2*xi*x*y
+  mad_tpsa_mul(x, y2, tmp);
+  mad_tpsa_axypbzpc(-1,dxi_ddel,tmp, 1,t, 0, t);// t - dxi_ddel*x*y^2
+
+  if (dir == -1) mad_tpsa_axypbzpc(kh,x,x, 1,px, 0, px); // reversal symmetry
+}
+
+void
+mad_track_tpsa_wedge (T *m[6], T *w[], num_t beta_inv, num_t dir, num_t k0,
+                      num_t e)
+{
+  const num_t b1 = dir*k0;
+
+  if (b1 == 0) {
+    mad_track_tpsa_yrot(m, w, e, beta_inv); return;
+  }
+
+  CHKM; M_DECL; (void)pt;
+  const num_t sa = sin(e), ca = cos(e), sa2 = sin(2*e);
+  T *pt2 = w[0], *pz = w[1], *pxt = w[2], *ptt = w[3], *pzs = w[4];
+  T *yt = w[5], *tmp = w[6];
+
+  tpsa_pt2(m, beta_inv, 0, 0, pt2);
+  tpsa_pt2(m, beta_inv, 1, 1, pz);
+  mad_tpsa_sqrt(pz, pz);
+
+  mad_tpsa_axpbypc(1,pz, -b1,x, 0, pxt);        // px*ca + (pz - b1*x)*sa
+  mad_tpsa_axpbypc(ca,px, sa,pxt, 0, pxt);
+
+  tpsa_pt2(m, beta_inv, 0, 1, ptt);             // pt2 - py^2
+  mad_tpsa_mul(pxt, pxt, pzs);
+  mad_tpsa_axpbypc(1,ptt, -1,pzs, 0, pzs);      // pt2 - py^2 - pxt^2
+  mad_tpsa_sqrt(ptt, ptt);
+  mad_tpsa_sqrt(pzs, pzs);
+
+  mad_tpsa_div (px, ptt, yt);                   // (e + asin(px/ptt) - asin(pxt/ptt))/b1
+  mad_tpsa_asin(yt, yt);
+  mad_tpsa_div (pxt, ptt, tmp);
+  mad_tpsa_asin(tmp, tmp);
+  mad_tpsa_axpbypc(1/b1,yt, -1/b1,tmp, e/b1, yt);
+
+  // x*ca + (x*px*sa2 + sa^2*(2*x*pz - b1*x^2)) / (pzs + pz*ca - px*sa)
+  mad_tpsa_axypbvwpc(sa2,x,px, 2*sa*sa,x,pz, 0, tmp);
+  mad_tpsa_mul(x, x, pt2);
+  mad_tpsa_axpbypc(1,tmp, -sa*sa*b1,pt2, 0, tmp);
+  mad_tpsa_axpbypc(1,pzs, ca,pz, 0, pt2);
+  mad_tpsa_axpbypc(1,pt2, -sa,px, 0, pt2);
+  mad_tpsa_div(tmp, pt2, tmp);
+  mad_tpsa_axpbypc(ca,x, 1,tmp, 0, x);
+
+  mad_tpsa_copy(pxt, px);
+  mad_tpsa_axypbzpc(1,py,yt, 1,y, 0, y);        // y + py*yt
+
+  tpsa_tfac(m, beta_inv, tmp);
+  mad_tpsa_axypbzpc(-1,yt,tmp, 1,t, 0, t);      // t - yt*(beta_inv+pt)
+}
+
+void
+mad_track_tpsa_fringe (T *m[6], T *w[], num_t beta_inv, num_t b, num_t fint,
+                       num_t hgap)
+{
+  CHKM; M_DECL; (void)pt;
+  const num_t fsad = fint*hgap != 0 ? 1/(fint*hgap*2)/36 : 0;
+  const num_t bfh2 = 2*b*fint*hgap;
+
+  T *rel_p2 = w[ 0], *pz  = w[ 1], *tf  = w[ 2], *c3  = w[ 3];
+  T *xp     = w[ 4], *yp  = w[ 5], *xp2 = w[ 6], *yp2 = w[ 7];
+  T *yp2_1  = w[ 8], *q   = w[ 9], *u   = w[10], *fi0 = w[11];
+  T *co2    = w[12], *co1 = w[13], *fi1 = w[14], *fi2 = w[15];
+  T *fi3    = w[16], *tmp = w[17];
+
+  tpsa_pt2(m, beta_inv, 0, 0, rel_p2);
+  tpsa_pt2(m, beta_inv, 1, 1, pz);
+  mad_tpsa_sqrt(pz, pz);
+  tpsa_tfac(m, beta_inv, tf);
+  mad_tpsa_invsqrt(rel_p2, b*b*fsad, c3);       // b^2*fsad/rel_p
+
+  mad_tpsa_div(px, pz, xp);
+  mad_tpsa_div(py, pz, yp);
+  mad_tpsa_mul(xp, xp, xp2);
+  mad_tpsa_mul(yp, yp, yp2);
+  mad_tpsa_axpb(1,yp2, 1, yp2_1);
+  mad_tpsa_div(xp, yp2_1, q);                   // xp/(1+yp^2)
+  mad_tpsa_axypbzpc(1,xp2,yp2, 2,xp2, 1, u);    // 1 + xp^2*(2+yp^2)
+
+  mad_tpsa_atan(q, fi0);
+  mad_tpsa_mul(u, pz, tmp);
+  mad_tpsa_axpbypc(1,fi0, -bfh2,tmp, 0, fi0);
+
+  mad_tpsa_cos(fi0, co2);                       // b/cos(fi0)^2
+  mad_tpsa_mul(co2, co2, co2);
+  mad_tpsa_inv(co2, b, co2);
+  mad_tpsa_mul(q, q, co1);                      // co2/(1+q^2)
+  mad_tpsa_set0(co1, 1,1);
+  mad_tpsa_div(co2, co1, co1);
+
+  // fi1 = co1/yp2_1 - co2*bfh2*(2*xp*(2 + yp2)*pz)
+  mad_tpsa_div(co1, yp2_1, fi1);
+  mad_tpsa_axypbzpc(1,xp,yp2, 2,xp, 0, tmp);
+  mad_tpsa_mul(tmp, pz, tmp);
+  mad_tpsa_mul(tmp, co2, tmp);
+  mad_tpsa_axpbypc(1,fi1, -2*bfh2,tmp, 0, fi1);
+
+  // fi2 = -2*co1*xp*yp/yp2_1^2 - co2*bfh2*(2*xp2*yp)*pz
+  mad_tpsa_mul(xp, yp, fi2);
+  mad_tpsa_mul(fi2, co1, fi2);
+  mad_tpsa_div(fi2, yp2_1, fi2);
+  mad_tpsa_div(fi2, yp2_1, fi2);
+  mad_tpsa_mul(xp2, yp, tmp);
+  mad_tpsa_mul(tmp, pz, tmp);
+  mad_tpsa_mul(tmp, co2, tmp);
+  mad_tpsa_axpbypc(-2,fi2, -2*bfh2,tmp, 0, fi2);
+
+  // fi3 = -co2*bfh2*(1 + xp2*(2 + yp2))
+  mad_tpsa_mul(co2, u, fi3);
+  mad_tpsa_scl(fi3, -bfh2, fi3);
+
+  mad_tpsa_tan(fi0, fi0);
+  mad_tpsa_scl(fi0, b, fi0);
+
+  // columns of the jacobian d(i,j) with i=1..3 [Forest ch 13.2.3]
+  T *by = co2, *bx = co1, *bt = q, *wxy = u, *y_ = xp2, *y2 = yp2;
+
+  mad_tpsa_mul(xp, yp, wxy);                    // xp*yp/pz
+  mad_tpsa_div(wxy, pz, wxy);
+
+  mad_tpsa_div(yp2_1, pz, tmp);                 // by
+  mad_tpsa_axypbvwpc(1,fi1,wxy, 1,fi2,tmp, 0, by);
+  mad_tpsa_axypbzpc(-1,fi3,yp, 1,by, 0, by);
+
+  mad_tpsa_axpb(1,xp2, 1, tmp);                 // bx
+  mad_tpsa_div(tmp, pz, tmp);
+  mad_tpsa_axypbvwpc(1,fi1,tmp, 1,fi2,wxy, 0, bx);
+  mad_tpsa_axypbzpc(-1,fi3,xp, 1,bx, 0, bx);
+
+  mad_tpsa_axypbvwpc(-1,fi1,xp, -1,fi2,yp, 0, bt); // bt
+  mad_tpsa_div(bt, pz, bt);
+  mad_tpsa_add(bt, fi3, bt);
+  mad_tpsa_mul(bt, tf, bt);
+  mad_tpsa_div(bt, pz, bt);
+
+  mad_tpsa_axypb(-2,by,y, 1, tmp);              // 2*y/(1 + sqrt(1 - 2*by*y))
+  mad_tpsa_sqrt(tmp, tmp);
+  mad_tpsa_set0(tmp, 1,1);
+  mad_tpsa_div(y, tmp, y_);
+  mad_tpsa_scl(y_, 2, y_);
+  mad_tpsa_mul(y_, y_, y2);
+
+  mad_tpsa_axypbzpc(-1,fi0,y_, 1,py, 0, py);    // py - fi0*y_ - 4*c3*y_^3
+  mad_tpsa_mul(y2, y_, tmp);
+  mad_tpsa_axypbzpc(-4,c3,tmp, 1,py, 0, py);
+  mad_tpsa_axypbzpc(0.5,bx,y2, 1,x, 0, x);      // x + bx*y_^2/2
+
+  mad_tpsa_axypbzpc(0.5,bt,y2, 1,t, 0, t);      // t + bt*y_^2/2 + c3*y_^4/rel_p2*tf
+  mad_tpsa_mul(y2, y2, tmp);
+  mad_tpsa_mul(tmp, c3, tmp);
+  mad_tpsa_div(tmp, rel_p2, tmp);
+  mad_tpsa_axypbzpc(1,tmp,tf, 1,t, 0, t);
+
+  mad_tpsa_copy(y_, y);
+}
+
+#undef CHKM
+#undef M_DECL
+#undef T
+
+// --- batched maps on particles (structure of arrays) ------------------------o
+
+// maps follow the Lua versions in madl_track.mad, one loop per map over the
+// np particles, coordinates are stored in the columns p[0..5] = x,px,y,py,t,pt
+
+#define CHKP     assert(p && p[0] && p[1] && p[2] && p[3] && p[4] && p[5])
+
+// particles are split in chunks of trk_chunk (~6 columns of 2kB in cache)
+// statically scheduled over the threads, so results do not depend on nthread
+
+int mad_track_nthread = 1;
+
+enum { trk_chunk = 256 };
+
+#ifdef _OPENMP
+#define OMP_FOR _Pragma("omp parallel for schedule(static,trk_chunk) \
+  num_threads(MAX(mad_track_nthread,1)) if(mad_track_nthread > 1 && np > trk_chunk)")
+#define OMP_CHK _Pragma("omp parallel for schedule(static) \
+  num_threads(MAX(mad_track_nthread,1)) if(mad_track_nthread > 1 && np > trk_chunk)")
+#else
+#define OMP_FOR
+#define OMP_CHK
+#endif
+
+// loop over the chunks [i,CHUNK_END(i)) of particles
+#define FOR_CHUNK(i) OMP_CHK for (ssz_t i=0; i < np; i += trk_chunk)
+#define CHUNK_END(i) MIN(i+trk_chunk, np)
+
+#define P_DECL \
+  num_t *restrict x = p[0], *restrict px = p[1], \
+        *restrict y = p[2], *restrict py = p[3], \
+        *restrict t = p[4], *restrict pt = p[5]
+
+// --- kernels on particles [i,n) ---------------------------------------------o
+
+typedef void (drift_ker_t) (ssz_t i, ssz_t n, num_t *p[6],
+                            num_t l, num_t beta_inv, num_t dt);
+typedef void (mult_ker_t)  (ssz_t i, ssz_t n, num_t *p[6],
+                            num_t dirch, int m, const num_t kn[], const num_t ks[]);
+
+static void
+drift_gen (ssz_t i, ssz_t n, num_t *p[6], num_t l, num_t beta_inv, num_t dt)
+{
+  P_DECL;
+  for (; i < n; i++) {
+    num_t l_pz = l/sqrt(1 + 2*beta_inv*pt[i] + pt[i]*pt[i]
+                          - px[i]*px[i] - py[i]*py[i]);
+    x[i] += px[i]*l_pz;
+    y[i] += py[i]*l_pz;
+    t[i] += dt - (beta_inv+pt[i])*l_pz;
+  }
+}
+
+static void
+mult_gen (ssz_t i, ssz_t n, num_t *p[6], num_t dirch,
+          int m, const num_t kn[], const num_t ks[])
+{
+  P_DECL; (void)t; (void)pt;
+  for (; i < n; i++) {
+    num_t by = kn[m-1], bx = ks[m-1], byt;
+    for (int j=m-2; j >= 0; j--) {
+      byt = x[i]*by - y[i]*bx + kn[j];
+      bx  = y[i]*by + x[i]*bx + ks[j];
+      by  = byt;
+    }
+    px[i] -= dirch*by;
+    py[i] += dirch*bx;
+  }
+}
+
+// --- optimized versions -----------------------------------------------------o
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  include "sse/mad_track_sse.tc"
+#else
+static inline drift_ker_t* drift_sel (void) { return drift_gen; }
+static inline mult_ker_t*  mult_sel  (void) { return  mult_gen; }
+str_t mad_track_simd (void) { return "none"; }
+#endif
+
+// --- batched maps -----------------------------------------------------------o
+
+void
+mad_track_strait_drift (ssz_t np, num_t *p[6], num_t l, num_t beta_inv, num_t T)
+{
+  CHKP;
+  const num_t dt = (1-T)*l*beta_inv;
+  drift_ker_t *ker = drift_sel();
+
+  FOR_CHUNK(i) ker(i, CHUNK_END(i), p, l, beta_inv, dt);
+}
+
+void
+mad_track_curved_drift (ssz_t np, num_t *p[6], num_t l, num_t beta_inv, num_t T,
+                        num_t rho)
+{
+  CHKP; P_DECL;
+  const num_t angle = l/rho, dt = (1-T)*l*beta_inv;
+  const num_t sa = sin(angle), ca = cos(angle), ta = tan(angle);
+  const num_t sa2 = sin(angle/2), sa2_2 = 2*sa2*sa2;
+
+  OMP_FOR
+  for (ssz_t i=0; i < np; i++) {
+    num_t pz  = sqrt(1 + 2*beta_inv*pt[i] + pt[i]*pt[i]
+                       - px[i]*px[i] - py[i]*py[i]);
+    num_t pz_ = 1/pz;
+    num_t ptt = 1 - ta*px[i]*pz_;
+    num_t xr  = x[i]+rho;
+    x [i] = (x[i] + rho*(sa2_2 + sa*px[i]*pz_)) / (ca*ptt);
+    px[i] = ca*px[i] + sa*pz;
+    y [i] += ta*xr*pz_*py[i]/ptt;
+    t [i] += dt - ta*xr*pz_*(beta_inv+pt[i]) / ptt;
+  }
+}
+
+void
+mad_track_solenoid_drift (ssz_t np, num_t *p[6], num_t l, num_t beta_inv,
+                          num_t T, num_t bsol)
+{
+  CHKP; P_DECL;
+  const num_t bsol2 = bsol*bsol, dt = (1-T)*l*beta_inv;
+
+  OMP_FOR
+  for (ssz_t i=0; i < np; i++) {
+    num_t xp = px[i] + bsol*y[i];
+    num_t yp = py[i] - bsol*x[i];
+
+    num_t l_pz  = l/sqrt(1 + 2*beta_inv*pt[i] + pt[i]*pt[i] - xp*xp - yp*yp);
+    num_t angle = l_pz*bsol;
+
+    num_t ca = cos(angle), sa = sin(angle);
+    num_t sc = fabs(angle) < 1e-10 ? 1 : sa/angle;
+
+    num_t xt  = ca*x [i] + l_pz*sc*px[i];
+    num_t pxt = ca*px[i] - l_pz*sc*x [i]*bsol2;
+    num_t yt  = ca*y [i] + l_pz*sc*py[i];
+    num_t pyt = ca*py[i] - l_pz*sc*y [i]*bsol2;
+
+    x [i] = ca*xt  + sa*yt;
+    px[i] = ca*pxt + sa*pyt;
+    y [i] = ca*yt  - sa*xt;
+    py[i] = ca*pyt - sa*pxt;
+    t [i] += dt - (beta_inv+pt[i])*l_pz;
+  }
+}
+
+void
+mad_track_strait_kick (ssz_t np, num_t *p[6], num_t lw, num_t dirch,
+                       int n, const num_t knl[n], const num_t ksl[n])
+{
+  CHKP;
+  if (n <= 0) return;
+
+  num_t kn[n], ks[n];
+  mult_coef(n, knl, ksl, lw, kn, ks);
+  mult_ker_t *ker = mult_sel();
+
+  FOR_CHUNK(i) ker(i, CHUNK_END(i), p, dirch, n, kn, ks);
+}
+
+void
+mad_track_curved_kick (ssz_t np, num_t *p[6], num_t lw, num_t dirch, num_t k0,
+                       int n, const num_t knl[n], const num_t ksl[n])
+{
+  CHKP; P_DECL; (void)t; (void)pt;
+  if (n <= 0) return;
+
+  num_t kn[n], ks[n];
+  mult_coef(n, knl, ksl, lw, kn, ks);
+
+  OMP_FOR
+  for (ssz_t i=0; i < np; i++) {
+    num_t by = kn[n-1], bx = ks[n-1], byt;
+    for (int j=n-2; j >= 0; j--) {
+      byt = x[i]*by - y[i]*bx + kn[j];
+      bx  = y[i]*by + x[i]*bx + ks[j];
+      by  = byt;
+    }
+    num_t hx = 1 + k0*x[i];
+    px[i] -= dirch*by*hx;
+    py[i] += dirch*bx*hx;
+  }
+}
+
+void
+mad_track_thin_kick (ssz_t np, num_t *p[6], num_t beta_inv, num_t dirch,
+                     num_t lrad, num_t knl1, num_t ksl1,
+                     int n, const num_t knl[n], const num_t ksl[n])
+{
+  CHKP; P_DECL;
+  if (n <= 0) return;
+
+  num_t kn[n], ks[n];
+  mult_coef(n, knl, ksl, 1, kn, ks);
+  mult_ker_t *ker = mult_sel();
+
+  // px += dirch*(knl1 - by), py += dirch*(bx - ksl1)
+  kn[0] -= knl1, ks[0] -= ksl1;
+
+  FOR_CHUNK(i) ker(i, CHUNK_END(i), p, dirch, n, kn, ks);
+
+  if (knl1 == 0 && ksl1 == 0) return;
+
+  OMP_FOR
+  for (ssz_t i=0; i < np; i++) {
+    num_t pz = sqrt(1 + 2*beta_inv*pt[i] + pt[i]*pt[i]);
+    if (lrad != 0) { // dipole focusing and deltap
+      px[i] += dirch*knl1*(pz-1) - knl1*knl1*x[i]/lrad;
+      py[i] += dirch*ksl1*(pz-1) - ksl1*ksl1*y[i]/lrad;
+    }
+    t[i] -= dirch*(knl1*x[i] - ksl1*y[i]) * (beta_inv+pt[i])/pz;
+  }
+}
+
+static void
+srot_ker (ssz_t np, num_t *p[6], num_t sa, num_t ca)
+{
+  CHKP; P_DECL; (void)t; (void)pt;
+
+  OMP_FOR
+  for (ssz_t i=0; i < np; i++) {
+    num_t x_ = x [i], y_  = y [i];
+    num_t px_= px[i], py_ = py[i];
+    x [i] = ca*x_  + sa*y_;
+    y [i] = ca*y_  - sa*x_;
+    px[i] = ca*px_ + sa*py_;
+    py[i] = ca*py_ - sa*px_;
+  }
+}
+
+void
+mad_track_srot (ssz_t np, num_t *p[6], num_t angle)
+{
+  srot_ker(np, p, sin(angle), cos(angle));
+}
+
+void
+mad_track_yrot (ssz_t np, num_t *p[6], num_t angle, num_t beta_inv)
+{
+  CHKP; P_DECL;
+  const num_t sa = sin(angle), ca = cos(angle), ta = tan(angle);
+
+  OMP_FOR
+  for (ssz_t i=0; i < np; i++) {
+    num_t pz  = sqrt(1 + 2*beta_inv*pt[i] + pt[i]*pt[i]
+                       - px[i]*px[i] - py[i]*py[i]);
+    num_t pz_ = 1/pz;
+    num_t ptt = 1 - ta*px[i]*pz_;
+    num_t x_  = x[i];
+    x [i] = x_/(ca*ptt);
+    px[i] = ca*px[i] + sa*pz;
+    y [i] += ta*x_*py[i]*pz_/ptt;
+    t [i] -= ta*x_*pz_*(beta_inv+pt[i])/ptt;
+  }
+}
+
+void
+mad_track_face (ssz_t np, num_t *p[6], num_t beta_inv, num_t dir, num_t k0,
+                num_t h)
+{
+  CHKP; P_DECL;
+  const num_t kh = dir*k0*h/2;
+
+  OMP_FOR
+  for (ssz_t i=0; i < np; i++) {
+    num_t x_ = x[i], px_ = px[i], y_ = y[i];
+
+    if (dir == 1) px_ += kh*x_*x_; // reversal symmetry, horizontal wedge
+
+    num_t ptt2 = 1 + 2*pt[i]*beta_inv + pt[i]*pt[i] - px_*px_;
+    num_t xi   = dir*sqrt(1 + 2*pt[i]*beta_inv + pt[i]*pt[i])*k0*h/ptt2;
+    num_t dxi_px   =  2*px_*xi/ptt2;
+    num_t dxi_ddel = -2*xi*(1 + pt[i])/ptt2;
+
+    x_   = x_ / (1-dxi_px*y_*y_);
+    px_ -= xi*y_*y_;
+    py[i] -= 2*xi*x_*y_;
+    t [i] -= dxi_ddel*x_*y_*y_;
+
+    if (dir == -1) px_ += kh*x_*x_; // reversal symmetry, horizontal wedge
+
+    x [i] = x_;
+    px[i] = px_;
+  }
+}
+
+void
+mad_track_wedge (ssz_t np, num_t *p[6], num_t beta_inv, num_t dir, num_t k0,
+                 num_t e)
+{
+  const num_t b1 = dir*k0;
+
+  if (b1 == 0) {
+    mad_track_yrot(np, p, e, beta_inv); return;
+  }
+
+  CHKP; P_DECL;
+  const num_t sa = sin(e), ca = cos(e), sa2 = sin(2*e);
+
+  OMP_FOR
+  for (ssz_t i=0; i < np; i++) {
+    num_t pt2 = 1 + 2*beta_inv*pt[i] + pt[i]*pt[i];
+    num_t pz  = sqrt(pt2 - px[i]*px[i] - py[i]*py[i]);
+    num_t pxt = px[i]*ca + (pz - b1*x[i])*sa;
+    num_t ptt = sqrt(pt2 - py[i]*py[i]);
+    num_t pzs = sqrt(pt2 - py[i]*py[i] - pxt*pxt);
+    num_t yt  = (e + asin(px[i]/ptt) - asin(pxt/ptt)) / b1;
+
+    x [i] = x[i]*ca + (x[i]*px[i]*sa2 + sa*sa*(2*x[i]*pz-b1*x[i]*x[i]))
+                    / (pzs+pz*ca-px[i]*sa);
+    px[i] = pxt;
+    y [i] += py[i]*yt;
+    t [i] -= yt*(beta_inv + pt[i]);
+  }
+}
+
+void
+mad_track_fringe (ssz_t np, num_t *p[6], num_t beta_inv, num_t b, num_t fint,
+                  num_t hgap)
+{
+  CHKP; P_DECL;
+  const num_t fsad = fint*hgap != 0 ? 1/(fint*hgap*2)/36 : 0;
+  const num_t bfh2 = 2*b*fint*hgap;
+
+  OMP_FOR
+  for (ssz_t i=0; i < np; i++) {
+    num_t rel_p2   = 1 + 2*beta_inv*pt[i] + pt[i]*pt[i];
+    num_t pz       = sqrt(rel_p2 - px[i]*px[i] - py[i]*py[i]);
+    num_t time_fac = beta_inv + pt[i];
+    num_t rel_p    = sqrt(rel_p2);
+    num_t c3       = b*b*fsad/rel_p;
+
+    num_t xp = px[i]/pz, yp = py[i]/pz;
+    num_t xp2 = xp*xp, yp2 = yp*yp, yp2_1 = 1 + yp2;
+
+    num_t fi0 = atan(xp/yp2_1) - bfh2*(1 + xp2*(2 + yp2))*pz;
+    num_t cf0 = cos(fi0);
+    num_t co2 = b/(cf0*cf0);
+    num_t co1 = co2/(1 + (xp/yp2_1)*(xp/yp2_1));
+
+    num_t fi1 =    co1/yp2_1         - co2*bfh2*(2*xp*(2 + yp2)*pz);
+    num_t fi2 = -2*co1*xp*yp/(yp2_1*yp2_1) - co2*bfh2*(2*xp2*yp)*pz;
+    num_t fi3 =                      - co2*bfh2*(1 + xp2*(2 + yp2));
+
+    fi0 = b*tan(fi0);
+
+    // columns of the jacobian d(i,j) with i=1..3 [Forest ch 13.2.3]
+    num_t by = fi1*(xp*yp/pz)  + fi2*((1+yp2)/pz) - fi3*yp;
+    num_t bx = fi1*((1+xp2)/pz) + fi2*(xp*yp/pz)  - fi3*xp;
+    num_t bt = -fi1*time_fac*xp/(pz*pz) - fi2*time_fac*yp/(pz*pz)
+               + fi3*time_fac/pz;
+
+    num_t y_ = 2*y[i]/(1 + sqrt(1 - 2*by*y[i])), y2 = y_*y_;
+
+    y [i]  = y_;
+    py[i] -= fi0*y_ + 4*c3*y2*y_;
+    x [i] += 0.5*bx*y2;
+    t [i] += 0.5*bt*y2 + c3*y2*y2/rel_p2*time_fac;
+  }
+}
+
+// --- lost particles ---------------------------------------------------------o
+
+// a coordinate is invalid if it is not finite (checked on the exponent bits to
+// be robust to -ffast-math) or if |x| or |y| exceeds maxamp
+
+static inline int
+is_invalid (num_t a)
+{
+  union { num_t d; u64_t u; } v = { a };
+  return (v.u & 0x7ff0000000000000ull) == 0x7ff0000000000000ull;
+}
+
+ssz_t
+mad_track_lost (ssz_t np, num_t *p[6], idx_t lost[], idx_t id, num_t maxamp)
+{
+  CHKP; P_DECL; assert(lost && id > 0);
+  ssz_t nl = 0;
+
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(static,trk_chunk) reduction(+:nl) \
+    num_threads(MAX(mad_track_nthread,1)) if(mad_track_nthread > 1 && np > trk_chunk)
+  #endif
+  for (ssz_t i=0; i < np; i++) {
+    if (lost[i]) continue;
+    if (is_invalid(x [i]) || is_invalid(y [i]) || is_invalid(t [i]) ||
+        is_invalid(px[i]) || is_invalid(py[i]) || is_invalid(pt[i]) ||
+        fabs(x[i]) > maxamp || fabs(y[i]) > maxamp)
+      lost[i] = id, ++nl;
+  }
+
+  return nl;
+}
+
+// --- tracking plan ----------------------------------------------------------o
+
+// a plan is a flat array of kernel records compiled once from a sequence (see
+// madl_track.mad) and replayed over turns on chunks of particles, each thread
+// runs all the records on its own chunks while they are hot in cache
+
+struct trk_rec {
+  int    op, n;       // kernel (enum trk_op), number of multipoles
+  num_t  a[6];        // kernel parameters, see mad_track.h
+  num_t *kn, *ks;     // multipole strengths (owned by the plan)
+};
+
+struct trk_plan {
+  ssz_t nrec, maxrec;
+  struct trk_rec *rec;
+};
+
+trk_plan_t*
+mad_track_plan_new (ssz_t nrec)
+{
+  trk_plan_t *pl = mad_malloc(sizeof *pl);
+  pl->nrec = 0, pl->maxrec = MAX(nrec, 16);
+  pl->rec  = mad_malloc(pl->maxrec * sizeof *pl->rec);
+  return pl;
+}
+
+void
+mad_track_plan_clear (trk_plan_t *pl)
+{
+  assert(pl);
+  for (ssz_t i=0; i < pl->nrec; i++)
+    mad_free(pl->rec[i].kn); // ks shares the same block
+  pl->nrec = 0;
+}
+
+void
+mad_track_plan_del (trk_plan_t *pl)
+{
+  if (!pl) return;
+  mad_track_plan_clear(pl);
+  mad_free(pl->rec);
+  mad_free(pl);
+}
+
+ssz_t
+mad_track_plan_len (const trk_plan_t *pl)
+{
+  assert(pl);
+  return pl->nrec;
+}
+
+void
+mad_track_plan_add (trk_plan_t *pl, int op, const num_t a[6],
+                    int n, const num_t knl_[], const num_t ksl_[])
+{
+  assert(pl && a);
+  ensure(op >= trk_chk && op <= trk_fringe, "invalid tracking plan kernel %d", op);
+
+  if (pl->nrec == pl->maxrec) {
+    pl->maxrec *= 2;
+    pl->rec = mad_realloc(pl->rec, pl->maxrec * sizeof *pl->rec);
+  }
+
+  struct trk_rec *r = &pl->rec[pl->nrec++];
+  r->op = op, r->n = 0, r->kn = r->ks = NULL;
+  memcpy(r->a, a, sizeof r->a);
+
+  switch (op) { // precompute what does not depend on the particles
+  case trk_strait_drift: // a = l, beta_inv, T -> a[2] = dt
+    r->a[2] = (1-a[2])*a[0]*a[1]; break;
+  case trk_srot:         // a = angle -> sin, cos
+    r->a[0] = sin(a[0]), r->a[1] = cos(a[0]); break;
+  }
+
+  if (n > 0) {
+    assert(knl_ && ksl_);
+    r->n  = n;
+    r->kn = mad_malloc(2*n * sizeof *r->kn);
+    r->ks = r->kn + n;
+    if (op == trk_strait_kick) // a = lw, dirch -> coefficients of the kernel
+      mult_coef(n, knl_, ksl_, a[0], r->kn, r->ks);
+    else {
+      memcpy(r->kn, knl_, n * sizeof *r->kn);
+      memcpy(r->ks, ksl_, n * sizeof *r->ks);
+    }
+  }
+}
+
+static inline ssz_t
+plan_run (const trk_plan_t *pl, ssz_t np, num_t *p[6], idx_t lost[], num_t maxamp)
+{
+  const struct trk_rec *r = pl->rec;
+  drift_ker_t *dker = drift_sel();
+  mult_ker_t  *mker =  mult_sel();
+  ssz_t nl = 0;
+
+  for (ssz_t k=0; k < pl->nrec; k++, r++) {
+    const num_t *a = r->a;
+    switch (r->op) {
+    case trk_chk:
+      nl += mad_track_lost(np, p, lost, (idx_t)a[0], maxamp); break;
+    case trk_strait_drift:
+      dker(0, np, p, a[0], a[1], a[2]); break;
+    case trk_curved_drift:
+      mad_track_curved_drift  (np, p, a[0], a[1], a[2], a[3]); break;
+    case trk_solenoid_drift:
+      mad_track_solenoid_drift(np, p, a[0], a[1], a[2], a[3]); break;
+    case trk_strait_kick:
+      if (r->n) mker(0, np, p, a[1], r->n, r->kn, r->ks);
+      break;
+    case trk_curved_kick:
+      mad_track_curved_kick(np, p, a[0], a[1], a[2], r->n, r->kn, r->ks); break;
+    case trk_thin_kick:
+      mad_track_thin_kick  (np, p, a[0], a[1], a[2], a[3], a[4], r->n, r->kn, r->ks); break;
+    case trk_srot:
+      srot_ker        (np, p, a[0], a[1]);             break;
+    case trk_yrot:
+      mad_track_yrot  (np, p, a[0], a[1]);             break;
+    case trk_face:
+      mad_track_face  (np, p, a[0], a[1], a[2], a[3]); break;
+    case trk_wedge:
+      mad_track_wedge (np, p, a[0], a[1], a[2], a[3]); break;
+    case trk_fringe:
+      mad_track_fringe(np, p, a[0], a[1], a[2], a[3]); break;
+    }
+  }
+  return nl;
+}
+
+ssz_t
+mad_track_plan_exec (const trk_plan_t *pl, ssz_t np, num_t *p[6], idx_t lost[],
+                     int nturn, num_t maxamp)
+{
+  CHKP; assert(pl && lost);
+  ssz_t nl = 0;
+
+  // one chunk per thread iteration, kernels see np <= trk_chunk and run serial
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(static) reduction(+:nl) \
+    num_threads(MAX(mad_track_nthread,1)) if(mad_track_nthread > 1 && np > trk_chunk)
+  #endif
+  for (ssz_t i=0; i < np; i += trk_chunk) {
+    ssz_t n = MIN(trk_chunk, np-i);
+    num_t *q[6] = { p[0]+i, p[1]+i, p[2]+i, p[3]+i, p[4]+i, p[5]+i };
+    for (int k=0; k < nturn; k++)
+      nl += plan_run(pl, n, q, lost+i, maxamp);
+  }
+
+  return nl;
+}
@@ -1,6 +1,8 @@
 #ifndef MAD_TRACK_H
 #define MAD_TRACK_H
 
+#include "mad_defs.h"
+
 // --- types -------------------------------------------------------------------
 
 struct tpsa;
@@ -12,7 +14,87 @@ struct tpsa;
 void mad_track_drift(T * restrict m[], num_t L, num_t B, num_t E);
 void mad_track_kick (T * restrict m[], num_t L, num_t B, int n, num_t Bn[n], num_t An[n]);
 
+// maps on tpsa: m[0..5] = x,px,y,py,t,pt is updated in place, w[] are the
+// trk_ntmp temporaries from mad_track_tmp_new (one set per map being tracked)
+
+enum { trk_ntmp = 18 };
+
+T**  mad_track_tmp_new             (const T *ref);
+void mad_track_tmp_del             (T *w[]);
+
+void mad_track_tpsa_strait_drift   (T *m[6], T *w[], num_t l, num_t beta_inv, num_t tpath);
+void mad_track_tpsa_curved_drift   (T *m[6], T *w[], num_t l, num_t beta_inv, num_t tpath, num_t rho);
+void mad_track_tpsa_solenoid_drift (T *m[6], T *w[], num_t l, num_t beta_inv, num_t tpath, num_t bsol);
+
+void mad_track_tpsa_strait_kick    (T *m[6], T *w[], num_t lw, num_t dirch,
+                                    int n, const num_t knl[n], const num_t ksl[n]);
+void mad_track_tpsa_curved_kick    (T *m[6], T *w[], num_t lw, num_t dirch, num_t k0,
+                                    int n, const num_t knl[n], const num_t ksl[n]);
+void mad_track_tpsa_thin_kick      (T *m[6], T *w[], num_t beta_inv, num_t dirch,
+                                    num_t lrad, num_t knl1, num_t ksl1,
+                                    int n, const num_t knl[n], const num_t ksl[n]);
+
+void mad_track_tpsa_srot           (T *m[6], T *w[], num_t angle);
+void mad_track_tpsa_yrot           (T *m[6], T *w[], num_t angle, num_t beta_inv);
+
+void mad_track_tpsa_face           (T *m[6], T *w[], num_t beta_inv, num_t dir, num_t k0, num_t h);
+void mad_track_tpsa_wedge          (T *m[6], T *w[], num_t beta_inv, num_t dir, num_t k0, num_t e);
+void mad_track_tpsa_fringe         (T *m[6], T *w[], num_t beta_inv, num_t b, num_t fint, num_t hgap);
+
 #undef T
 
+// number of threads used by the batched maps (default 1)
+extern int mad_track_nthread;
+
+// instruction set used by the batched drift and multipole kernels
+str_t mad_track_simd (void);
+
+// batched maps, particles are stored as structure of arrays:
+// p[0..5] point to the columns x, px, y, py, t, pt of the np particles
+
+void mad_track_strait_drift  (ssz_t np, num_t *p[6], num_t l, num_t beta_inv, num_t T);
+void mad_track_curved_drift  (ssz_t np, num_t *p[6], num_t l, num_t beta_inv, num_t T, num_t rho);
+void mad_track_solenoid_drift(ssz_t np, num_t *p[6], num_t l, num_t beta_inv, num_t T, num_t bsol);
+
+void mad_track_strait_kick   (ssz_t np, num_t *p[6], num_t lw, num_t dirch,
+                              int n, const num_t knl[n], const num_t ksl[n]);
+void mad_track_curved_kick   (ssz_t np, num_t *p[6], num_t lw, num_t dirch, num_t k0,
+                              int n, const num_t knl[n], const num_t ksl[n]);
+void mad_track_thin_kick     (ssz_t np, num_t *p[6], num_t beta_inv, num_t dirch,
+                              num_t lrad, num_t knl1, num_t ksl1,
+                              int n, const num_t knl[n], const num_t ksl[n]);
+
+void mad_track_srot          (ssz_t np, num_t *p[6], num_t angle);
+void mad_track_yrot          (ssz_t np, num_t *p[6], num_t angle, num_t beta_inv);
+
+void mad_track_face          (ssz_t np, num_t *p[6], num_t beta_inv, num_t dir, num_t k0, num_t h);
+void mad_track_wedge         (ssz_t np, num_t *p[6], num_t beta_inv, num_t dir, num_t k0, num_t e);
+void mad_track_fringe        (ssz_t np, num_t *p[6], num_t beta_inv, num_t b, num_t fint, num_t hgap);
+
+// lost particles: set lost[i]=id for new invalid particles, return their count
+ssz_t mad_track_lost         (ssz_t np, num_t *p[6], idx_t lost[], idx_t id, num_t maxamp);
+
+// tracking plan: flat array of batched maps replayed over turns, the record
+// parameters a[] are the arguments of the maps above after (np, p) without the
+// multipoles (n, knl, ksl), and a[0] = id for the lost particles check (trk_chk)
+
+typedef struct trk_plan trk_plan_t;
+
+enum trk_op {
+  trk_chk,
+  trk_strait_drift, trk_curved_drift, trk_solenoid_drift,
+  trk_strait_kick , trk_curved_kick , trk_thin_kick,
+  trk_srot, trk_yrot, trk_face, trk_wedge, trk_fringe,
+};
+
+trk_plan_t* mad_track_plan_new   (ssz_t nrec);
+void        mad_track_plan_del   (trk_plan_t *pl);
+void        mad_track_plan_clear (trk_plan_t *pl);
+ssz_t       mad_track_plan_len   (const trk_plan_t *pl);
+void        mad_track_plan_add   (trk_plan_t *pl, int op, const num_t a[6],
+                                  int n, const num_t knl[], const num_t ksl[]);
+ssz_t       mad_track_plan_exec  (const trk_plan_t *pl, ssz_t np, num_t *p[6],
+                                  idx_t lost[], int nturn, num_t maxamp);
+
 // -----------------------------------------------------------------------------
 #endif
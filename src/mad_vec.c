@@ -22,6 +22,7 @@
 #include <complex.h>
 #include <assert.h>
 
+#include "mad_cst.h"
 #include "mad_log.h"
 #include "mad_mem.h"
 #include "mad_vec.h"
@@ -360,8 +361,198 @@ void mad_cvec_kadd (int k, const cnum_t a[], const cnum_t *x[], cnum_t r[], ssz_
 
 // -- FFT ---------------------------------------------------------------------o
 
+/* Plans cache
+  FFTW plans are created once per (kind, sizes, alignments, in-place) and reused
+  through the new-array execute functions. Planning is done on scratch arrays
+  with the same alignments as the arguments, so rigors above FFTW_ESTIMATE never
+  overwrite them. Beyond the cache capacity, the least recently used plan not
+  being executed is replaced, or if all are, the plan is used once. Plans being
+  executed are destroyed by their last user when flushed (e.g. rigor changes).
+  Kinds or'ed with mad_fft_rows transform the m rows of length n independently.
+  The wisdom is loaded on first planning from the file $MAD_FFTW_WISDOM if set,
+  and can be saved or loaded with mad_fft_wisdom.
+*/
+
 #include <fftw3.h>
 
+enum { fft_max = 64 }; // cache capacity
+
+static struct {
+  fftw_plan p;               // NULL if the slot is free
+  int   kind, inpl, ax, ar;
+  int   use, old;            // #running executions, flushed while running
+  ssz_t m, n;
+  unsigned long long tck;    // last use
+} fft_cache[fft_max];
+
+static unsigned long long fft_tck;
+static int fft_rig, fft_ini;
+
+static const unsigned fft_flg[] = {
+  FFTW_ESTIMATE, FFTW_MEASURE, FFTW_PATIENT, FFTW_EXHAUSTIVE
+};
+
+static fftw_plan
+fft_plan (int kind, ssz_t m, ssz_t n, int inpl, int ax, int ar)
+{
+  // return NULL on failure, errors are raised outside of the critical section
+  size_t sx = m*n*sizeof(cnum_t), sr = sx;
+  if (kind == mad_fft_r2c) sx = m*n*sizeof(num_t), sr = m*(n/2+1)*sizeof(cnum_t);
+  if (kind == mad_fft_c2r) sr = m*n*sizeof(num_t), sx = m*(n/2+1)*sizeof(cnum_t);
+  if (inpl) sx = sr = MAX(sx, sr);
+
+  // scratch arrays with the alignments of the arguments
+  char *bx = fftw_malloc(sx+ax), *br = inpl ? bx : fftw_malloc(sr+ar);
+  void *x  = bx+ax, *r = inpl ? x : br+ar;
+
+  // 2D transform or m transforms of length n (rows)
+  int rows = kind & mad_fft_rows;  kind &= ~mad_fft_rows;
+  int nn[2] = { m, n }, rk = m > 1 && !rows ? 2 : 1, *dim = nn+2-rk;
+  int hm = rows ? m : 1, dx = n, dr = n;
+  if (kind == mad_fft_r2c) dr = n/2+1;
+  if (kind == mad_fft_c2r) dx = n/2+1;
+  unsigned flg = fft_flg[fft_rig];
+  fftw_plan p = NULL;
+
+  switch (kind) {
+  case mad_fft_fwd:
+    p = fftw_plan_many_dft    (rk,dim,hm, x,NULL,1,dx, r,NULL,1,dr, FFTW_FORWARD ,flg);
+    break;
+  case mad_fft_bwd:
+    p = fftw_plan_many_dft    (rk,dim,hm, x,NULL,1,dx, r,NULL,1,dr, FFTW_BACKWARD,flg);
+    break;
+  case mad_fft_r2c:
+    p = fftw_plan_many_dft_r2c(rk,dim,hm, x,NULL,1,dx, r,NULL,1,dr, flg);
+    break;
+  case mad_fft_c2r:
+    p = fftw_plan_many_dft_c2r(rk,dim,hm, x,NULL,1,dx, r,NULL,1,dr, flg);
+    break;
+  }
+
+  if (!inpl) fftw_free(br);
+  fftw_free(bx);
+  return p;
+}
+
+static fftw_plan
+fft_find (int kind, ssz_t m, ssz_t n, int inpl, int ax, int ar, int *slot)
+{
+  // return the plan in use in *slot, -1 if it must be destroyed after use
+  if (!fft_ini) {
+    str_t fname = getenv("MAD_FFTW_WISDOM");
+    if (fname) fftw_import_wisdom_from_filename(fname);
+    fft_ini = 1;
+  }
+
+  int v = -1; // slot to (re)use: free first, then least recently used
+  for (int i=0; i < fft_max; i++) {
+    if (!fft_cache[i].p) { if (v < 0 || fft_cache[v].p) v = i; continue; }
+    if (fft_cache[i].old) continue;
+    if (fft_cache[i].kind == kind && fft_cache[i].m  == m  &&
+        fft_cache[i].n    == n    && fft_cache[i].ax == ax &&
+        fft_cache[i].ar   == ar   && fft_cache[i].inpl == inpl) {
+      fft_cache[i].use += 1, fft_cache[i].tck = ++fft_tck;
+      return *slot = i, fft_cache[i].p;
+    }
+    if (!fft_cache[i].use && (v < 0 || (fft_cache[v].p && fft_cache[i].tck < fft_cache[v].tck)))
+      v = i;
+  }
+
+  fftw_plan p = fft_plan(kind, m, n, inpl, ax, ar);
+  *slot = -1;
+  if (!p || v < 0) return p; // failed or all cached plans running
+
+  if (fft_cache[v].p) fftw_destroy_plan(fft_cache[v].p);
+  fft_cache[v].p    = p;
+  fft_cache[v].kind = kind, fft_cache[v].inpl = inpl;
+  fft_cache[v].ax   = ax  , fft_cache[v].ar   = ar;
+  fft_cache[v].m    = m   , fft_cache[v].n    = n;
+  fft_cache[v].use  = 1   , fft_cache[v].old  = 0;
+  fft_cache[v].tck  = ++fft_tck;
+  return *slot = v, p;
+}
+
+static void
+fft_release (int slot, fftw_plan p)
+{
+  if (slot < 0) { fftw_destroy_plan(p); return; }
+  if (!--fft_cache[slot].use && fft_cache[slot].old)
+    fftw_destroy_plan(p), fft_cache[slot].p = NULL, fft_cache[slot].old = 0;
+}
+
+static void
+fft_flush (void)
+{
+  for (int i=0; i < fft_max; i++)
+    if (fft_cache[i].p && !fft_cache[i].old) {
+      if (fft_cache[i].use) fft_cache[i].old = 1;
+      else fftw_destroy_plan(fft_cache[i].p), fft_cache[i].p = NULL;
+    }
+}
+
+void // x [m x n] -> r [m x n], (r2c) r [m x n/2+1], (c2r) x [m x n/2+1]
+mad_fft_exec (int kind, ssz_t m, ssz_t n, const void *x, void *r)
+{
+  CHKXR;
+  ensure((kind & ~mad_fft_rows) <= mad_fft_c2r && kind >= 0, "invalid FFT kind %d", kind);
+  int inpl = x == r, slot;
+  int ax = fftw_alignment_of((num_t*)x), ar = fftw_alignment_of(r);
+  fftw_plan p;
+
+  // FFTW planner is not thread safe, executing a plan is
+  #ifdef _OPENMP
+  #pragma omp critical (mad_fft)
+  #endif
+  p = fft_find(kind, m, n, inpl, ax, ar, &slot);
+
+  if (!p) error("FFTW failed to create a plan");
+
+  switch (kind & ~mad_fft_rows) {
+  case mad_fft_r2c: fftw_execute_dft_r2c(p, (num_t *)x, r); break;
+  case mad_fft_c2r: fftw_execute_dft_c2r(p, (cnum_t*)x, r); break;
+  default:          fftw_execute_dft    (p, (cnum_t*)x, r); break;
+  }
+
+  #ifdef _OPENMP
+  #pragma omp critical (mad_fft)
+  #endif
+  fft_release(slot, p);
+}
+
+int
+mad_fft_rigor (int rigor)
+{
+  ensure(rigor >= -1 && rigor <= 3, "invalid FFT rigor %d", rigor);
+  int old = fft_rig;
+  if (rigor >= 0 && rigor != old) {
+    #ifdef _OPENMP
+    #pragma omp critical (mad_fft)
+    #endif
+    fft_flush(), fft_rig = rigor;
+  }
+  return old;
+}
+
+int
+mad_fft_wisdom (str_t fname, int save)
+{
+  assert(fname);
+  int ok;
+  #ifdef _OPENMP
+  #pragma omp critical (mad_fft)
+  #endif
+  ok = save ? fftw_export_wisdom_to_filename  (fname)
+            : fftw_import_wisdom_from_filename(fname);
+  return ok;
+}
+
+void
+mad_fft_cleanup (void)
+{
+  fft_flush(), fft_ini = 0;
+  fftw_cleanup();
+}
+
 void // x [n] -> r [n]
 mad_vec_fft (const num_t x[], cnum_t r[], ssz_t n)
 {
@@ -376,27 +567,21 @@ void // x [n] -> r [n/2+1]
 mad_vec_rfft (const num_t x[], cnum_t r[], ssz_t n)
 {
   CHKXR;
-  fftw_plan p = fftw_plan_dft_r2c_1d(n, (num_t*)x, r, FFTW_ESTIMATE);
-  fftw_execute(p);
-  fftw_destroy_plan(p);
+  mad_fft_exec(mad_fft_r2c, 1, n, x, r);
 }
 
 void
 mad_cvec_fft (const cnum_t x[], cnum_t r[], ssz_t n)
 {
   CHKXR;
-  fftw_plan p = fftw_plan_dft_1d(n, (cnum_t*)x, r, FFTW_FORWARD, FFTW_ESTIMATE);
-  fftw_execute(p);
-  fftw_destroy_plan(p);
+  mad_fft_exec(mad_fft_fwd, 1, n, x, r);
 }
 
 void
 mad_cvec_ifft(const cnum_t x[], cnum_t r[], ssz_t n)
 {
   CHKXR;
-  fftw_plan p = fftw_plan_dft_1d(n, (cnum_t*)x, r, FFTW_BACKWARD, FFTW_ESTIMATE);
-  fftw_execute(p);
-  fftw_destroy_plan(p);
+  mad_fft_exec(mad_fft_bwd, 1, n, x, r);
   mad_cvec_muln(r, 1.0/n, r, n);
 }
 
@@ -406,14 +591,180 @@ mad_cvec_irfft (const cnum_t x[], num_t r[], ssz_t n)
   CHKXR;
   ssz_t nn = n/2+1;
   mad_alloc_tmp(cnum_t, cx, nn);
-  mad_cvec_copy(x, cx, nn);
-  fftw_plan p = fftw_plan_dft_c2r_1d(n, cx, r, FFTW_ESTIMATE);
-  fftw_execute(p);
-  fftw_destroy_plan(p);
+  mad_cvec_copy(x, cx, nn); // c2r destroys its input
+  mad_fft_exec(mad_fft_c2r, 1, n, cx, r);
   mad_free_tmp(cx);
   mad_vec_muln(r, 1.0/n, r, n);
 }
 
+/* -- NAFF --------------------------------------------------------------------o
+[1] J. Laskar, "Frequency analysis for multi-dimensional systems. Global
+    dynamics and diffusion", Physica D 67 (1993) 257-281.
+[2] J. Laskar, "Introduction to frequency map analysis", Proc. of 3DHAM95 NATO
+    Advanced Study Institute, S'Agaro, (1995) 134-150.
+
+NAFF searches iteratively the k main frequencies of a complex signal x[n]:
+  - the residual y (initially x) weighted by a Hann window is FFTed to locate
+    the peak bin, then the frequency is refined within +/- one bin as the zero
+    of d|<y,e_nu>|^2/dnu, where e_nu[j] = exp(i 2pi nu j).
+  - e_nu is orthonormalized against the previous exponentials (Gram-Schmidt),
+    and its projection is subtracted from the residual.
+  - the amplitudes of the exponentials are recovered from the orthonormal basis.
+The results satisfy x[j] ~ sum_q amp[q] exp(i (2pi frq[q] j + phs[q])) with frq
+in [0,1), the number of frequencies found is returned, missing ones are zero.
+*/
+
+enum { naff_blk = 8   }; // phasors computed together (vectorization)
+enum { naff_itr = 100 }; // max number of iterations to refine a frequency
+
+static inline num_t
+naff_win (ssz_t j, ssz_t n)
+{
+  return 1 - cos(2*M_PI*j/n); // Hann window of mean 1
+}
+
+static inline cnum_t
+naff_dot (const cnum_t wy[], num_t nu, cnum_t *dr, ssz_t n)
+{
+  // sum_j wy[j] exp(-i 2pi nu j) and its derivative vs nu
+  enum { B = naff_blk };
+  cnum_t z[B], acc[B], dacc[B], s = cexp(-2*M_PI*I*nu*B), r = 0, d = 0;
+  for (int b=0; b < B; b++)
+    z[b] = cexp(-2*M_PI*I*nu*b), acc[b] = dacc[b] = 0;
+
+  ssz_t j = 0;
+  for (; j+B <= n; j += B)
+    for (int b=0; b < B; b++) {
+      cnum_t v = wy[j+b]*z[b];
+      acc[b] += v, dacc[b] += (j+b)*v, z[b] *= s;
+    }
+  for (int b=0; j+b < n; b++) {
+    cnum_t v = wy[j+b]*z[b];
+    r += v, d += (j+b)*v;
+  }
+  for (int b=0; b < B; b++) r += acc[b], d += dacc[b];
+
+  *dr = -2*M_PI*I*d;
+  return r;
+}
+
+static inline num_t
+naff_slope (const cnum_t wy[], num_t nu, ssz_t n)
+{
+  // d|<y,e_nu>|^2/dnu / 2
+  cnum_t d, r = naff_dot(wy, nu, &d, n);
+  return creal(d*conj(r));
+}
+
+static num_t
+naff_peak (const cnum_t wy[], num_t a, num_t b, ssz_t n)
+{
+  // zero of the slope in [a,b] (Illinois), max of |<y,e_nu>| otherwise
+  num_t fa = naff_slope(wy, a, n), fb = naff_slope(wy, b, n);
+
+  if (fa > 0 && fb < 0) {
+    num_t c = a, p;
+    for (int i=0, side=0; i < naff_itr; i++) {
+      p = c, c = (a*fb - b*fa) / (fb - fa);
+      if (fabs(c-p) <= 1e-16) break;
+      num_t fc = naff_slope(wy, c, n);
+      if (fc == 0) break;
+      if (fc < 0) { b = c, fb = fc; if (side < 0) fa /= 2; side = -1; }
+      else        { a = c, fa = fc; if (side > 0) fb /= 2; side = +1; }
+    }
+    return c;
+  }
+
+  // golden section search (interferences)
+  const num_t g = (sqrt(5)-1)/2;
+  cnum_t dr;
+  num_t c = b - g*(b-a), fc = cabs(naff_dot(wy, c, &dr, n));
+  num_t d = a + g*(b-a), fd = cabs(naff_dot(wy, d, &dr, n));
+  for (int i=0; i < naff_itr && b-a > 1e-16; i++) {
+    if (fc > fd) b = d, d = c, fd = fc, c = b - g*(b-a),
+                 fc = cabs(naff_dot(wy, c, &dr, n));
+    else         a = c, c = d, fc = fd, d = a + g*(b-a),
+                 fd = cabs(naff_dot(wy, d, &dr, n));
+  }
+  return (a+b)/2;
+}
+
+static inline cnum_t
+naff_prod (const cnum_t x[], const cnum_t y[], const num_t w[], ssz_t n)
+{
+  // windowed inner product <x,y>
+  cnum_t r = 0;
+  for (ssz_t j=0; j < n; j++) r += w[j]*x[j]*conj(y[j]);
+  return r/n;
+}
+
+int
+mad_cvec_naff (const cnum_t x[], num_t frq[], num_t amp[], num_t phs[], ssz_t n, ssz_t k)
+{
+  assert( x && frq && amp && phs );
+  ensure(n > 1 && k > 0, "invalid NAFF sizes (n=%d, k=%d)", n, k);
+
+  mad_alloc_tmp(num_t , w , n);
+  mad_alloc_tmp(cnum_t, y , n);
+  mad_alloc_tmp(cnum_t, wy, n);
+  mad_alloc_tmp(cnum_t, c , k);
+  cnum_t *u = mad_malloc(k*n * sizeof *u); // orthonormal basis
+  cnum_t *a = mad_malloc(k*k * sizeof *a); // u[q] = sum_p a[q][p] e[p]
+
+  for (ssz_t j=0; j < n; j++) w[j] = naff_win(j, n);
+  mad_cvec_copy(x, y, n);
+
+  ssz_t nf = 0;
+  for (; nf < k; nf++) {
+    cnum_t *uq = u+nf*n, *aq = a+nf*k;
+
+    // peak of the windowed residual spectrum
+    for (ssz_t j=0; j < n; j++) wy[j] = w[j]*y[j];
+    mad_cvec_fft(wy, uq, n);
+    ssz_t ip = 0;
+    num_t vp = 0;
+    for (ssz_t j=0; j < n; j++) {
+      num_t v = creal(uq[j]*conj(uq[j]));
+      if (v > vp) ip = j, vp = v;
+    }
+    if (vp == 0) break;
+
+    // refined frequency in [0,1)
+    num_t nu = naff_peak(wy, (ip-1.0)/n, (ip+1.0)/n, n);
+    frq[nf] = nu - floor(nu);
+
+    // Gram-Schmidt of e_nu against u[0..nf-1]
+    for (ssz_t p=0; p <= nf; p++) aq[p] = p == nf;
+    for (ssz_t j=0; j < n; j++) uq[j] = cexp(2*M_PI*I*frq[nf]*j);
+    for (ssz_t p=0; p < nf; p++) {
+      cnum_t cp = naff_prod(uq, u+p*n, w, n);
+      for (ssz_t j=0; j <  n; j++) uq[j] -= cp*u[p*n+j];
+      for (ssz_t i=0; i <= p; i++) aq[i] -= cp*a[p*k+i];
+    }
+    num_t nrm = sqrt(creal(naff_prod(uq, uq, w, n)));
+    if (nrm < 1e-12) break; // frequency already found
+
+    for (ssz_t j=0; j <  n; j++) uq[j] /= nrm;
+    for (ssz_t i=0; i <= nf; i++) aq[i] /= nrm;
+
+    // subtract the projection from the residual
+    c[nf] = naff_prod(y, uq, w, n);
+    for (ssz_t j=0; j < n; j++) y[j] -= c[nf]*uq[j];
+  }
+
+  // amplitudes of the exponentials, x = sum_q c[q] u[q] = sum_p (...) e[p]
+  for (ssz_t p=0; p < k; p++) {
+    cnum_t ap = 0;
+    for (ssz_t q=p; q < nf; q++) ap += c[q]*a[q*k+p];
+    if (p >= nf) frq[p] = 0;
+    amp[p] = cabs(ap), phs[p] = carg(ap);
+  }
+
+  mad_free(a); mad_free(u);
+  mad_free_tmp(c); mad_free_tmp(wy); mad_free_tmp(y); mad_free_tmp(w);
+  return nf;
+}
+
 /* -- NFFT --------------------------------------------------------------------o
 [1] J. Keiner, S. Kunis and D. Potts, "Using NFFT 3 — A Software Library for
     Various Nonequispaced Fast Fourier Transforms", ACM Transactions on
@@ -458,12 +809,179 @@ forward NFFT, i.e. time to frequency:
 backward NFFT, i.e. frequency to time:
   - Use nfft_trafo with negated input time nodes and shifted input frequency
     indexes by length/2, and normalized output signal by 1/length.
+
+Plans:
+  NFFT plans are objects created for given sizes by mad_nfft_new, with nodes
+  set by mad_nfft_nodes. A plan can be used by one thread at a time, different
+  plans can be used concurrently. The NFFT wrappers share a small cache of plans
+  keyed by sizes and nodes (hashed), so alternating node sets do not precompute
+  the nodes again, the least recently used plan being replaced. Missing nodes
+  mean the nodes of the last call with the same sizes. Errors are raised after
+  leaving the critical section of the cache.
 */
 
 #include <nfft3.h>
 
-static nfft_plan p;
-static ssz_t p_n, p_m;
+struct nfft {
+  nfft_plan p;
+  ssz_t m, n, nr, nx; // sizes and #nodes
+  int   nodes;        // nodes are set
+};
+
+enum { nfft_max = 8 }; // cache capacity
+
+static struct {
+  nfft_t *p;
+  unsigned long long h, tck; // hash of the nodes, last use
+} nfft_cache[nfft_max];
+
+static unsigned long long nfft_tck;
+static int nfft_cnt;
+
+nfft_t*
+mad_nfft_new (ssz_t m, ssz_t n, ssz_t nr)
+{
+  ensure(m > 0 && n > 0 && nr > 0, "invalid NFFT sizes");
+  nfft_t *p = mad_malloc(sizeof *p);
+  p->m = m, p->n = n, p->nr = nr, p->nx = m*n, p->nodes = 0;
+
+  // the FFTW planner is not thread safe (see mad_fft_exec)
+  #ifdef _OPENMP
+  #pragma omp critical (mad_fft)
+  #endif
+  if (m == 1) nfft_init_1d(&p->p,    n, nr);
+  else        nfft_init_2d(&p->p, m, n, nr);
+
+  return p;
+}
+
+void
+mad_nfft_del (nfft_t *p)
+{
+  if (!p) return;
+  #ifdef _OPENMP
+  #pragma omp critical (mad_fft)
+  #endif
+  nfft_finalize(&p->p);
+  mad_free(p);
+}
+
+void
+mad_nfft_nodes (nfft_t *p, const num_t x_node[])
+{
+  assert( p && x_node );
+  int same = p->nodes;
+  for (ssz_t i=0; i < p->nx; i++) { // transforms need -x_node
+    num_t x = x_node[i] == -0.5 ? 0.4999999999999999 : -x_node[i];
+    if (same && p->p.x[i] != x) same = 0;
+    p->p.x[i] = x;
+  }
+  if (!same && (p->p.flags & PRE_ONE_PSI)) nfft_precompute_one_psi(&p->p);
+  p->nodes = 1;
+}
+
+static const char*
+nfft_run (nfft_t *p, int bwd, const cnum_t x[], cnum_t r[])
+{
+  // return the error message, if any
+  if (!p->nodes) return "missing NFFT nodes";
+  ssz_t nr = p->nr;
+  const char *err;
+
+  if (bwd) { // frequency to time
+    mad_cvec_copy(x+nr/2, p->p.f_hat, nr/2); // for compatibility with FFTW
+    mad_cvec_copy(x, p->p.f_hat+nr/2, nr/2);
+    if ((err = nfft_check(&p->p))) return err;
+    nfft_trafo(&p->p); // nfft_trafo_direct(&p->p);
+    mad_cvec_copy(p->p.f, r, p->nx);
+    mad_cvec_muln(r, 1.0/p->nx, r, p->nx);
+  } else {   // time to frequency
+    mad_cvec_copy(x, p->p.f, p->nx);
+    if ((err = nfft_check(&p->p))) return err;
+    nfft_adjoint(&p->p); // nfft_adjoint_direct(&p->p);
+    mad_cvec_copy(p->p.f_hat+nr/2, r, nr/2); // for compatibility with FFTW
+    mad_cvec_copy(p->p.f_hat, r+nr/2, nr/2);
+  }
+  return NULL;
+}
+
+void // time to frequency
+mad_nfft_fwd (nfft_t *p, const cnum_t x[], cnum_t r[])
+{
+  assert( p && x && r );
+  const char *err = nfft_run(p, 0, x, r);
+  if (err) error("%s", err);
+}
+
+void // frequency to time
+mad_nfft_bwd (nfft_t *p, const cnum_t x[], cnum_t r[])
+{
+  assert( p && x && r );
+  const char *err = nfft_run(p, 1, x, r);
+  if (err) error("%s", err);
+}
+
+static inline unsigned long long
+nfft_hash (const num_t node[], ssz_t nx)
+{
+  // FNV-1a of the nodes
+  const unsigned char *b = (const unsigned char*)node;
+  unsigned long long h = 14695981039346656037ull;
+  for (size_t i=0; i < nx*sizeof *node; i++)
+    h = (h ^ b[i]) * 1099511628211ull;
+  return h;
+}
+
+static const char*
+nfft_exec (int bwd, ssz_t m, ssz_t n, ssz_t nr, const num_t node_[],
+           const cnum_t x[], cnum_t r[])
+{
+  // plan with the same sizes and nodes, the last one used if nodes are missing
+  unsigned long long h = node_ ? nfft_hash(node_, m*n) : 0;
+  int k = -1, v = 0;
+  for (int i=0; i < nfft_cnt; i++) {
+    const nfft_t *p = nfft_cache[i].p;
+    if (p->m == m && p->n == n && p->nr == nr && (!node_ || nfft_cache[i].h == h)
+        && (k < 0 || nfft_cache[i].tck > nfft_cache[k].tck))
+      k = i;
+    if (nfft_cache[i].tck < nfft_cache[v].tck) v = i;
+  }
+
+  if (k < 0) { // new plan, least recently used replaced
+    if (!node_) return "missing NFFT nodes";
+    if (nfft_cnt < nfft_max) v = nfft_cnt++;
+    else mad_nfft_del(nfft_cache[v].p);
+    nfft_cache[v].p = mad_nfft_new(m, n, nr), k = v;
+  }
+
+  nfft_t *p = nfft_cache[k].p;
+  nfft_cache[k].tck = ++nfft_tck;
+  if (node_) mad_nfft_nodes(p, node_), nfft_cache[k].h = h;
+  return nfft_run(p, bwd, x, r);
+}
+
+void // cached plans
+mad_nfft_exec (int bwd, ssz_t m, ssz_t n, ssz_t nr, const num_t node_[],
+               const cnum_t x[], cnum_t r[])
+{
+  assert( x && r );
+  ensure(m > 0 && n > 0 && nr > 0, "invalid NFFT sizes");
+  const char *err;
+
+  #ifdef _OPENMP
+  #pragma omp critical (mad_nfft)
+  #endif
+  err = nfft_exec(bwd, m, n, nr, node_, x, r);
+
+  if (err) error("%s", err);
+}
+
+void
+mad_nfft_cleanup (void)
+{
+  for (int i=0; i < nfft_cnt; i++) mad_nfft_del(nfft_cache[i].p);
+  nfft_cnt = 0;
+}
 
 void
 mad_vec_nfft (const num_t x[], const num_t x_node[], cnum_t r[], ssz_t n, ssz_t nr)
@@ -478,48 +996,13 @@ mad_vec_nfft (const num_t x[], const num_t x_node[], cnum_t r[], ssz_t n, ssz_t
 void // time to frequency
 mad_cvec_nfft (const cnum_t x[], const num_t x_node[], cnum_t r[], ssz_t n, ssz_t nr)
 {
-  assert( x && r );
-  int precomp = 0;
-  if (n != p_n || nr != p_m) {
-    nfft_finalize(&p);
-    nfft_init_1d (&p, n, nr);
-    p_n = n, p_m = nr, precomp = 1;
-  }
-  if (x_node || precomp) {
-    for (ssz_t i=0; i < n; i++)  // adjoint transform needs -x_node
-      p.x[i] = x_node[i] == -0.5 ? 0.4999999999999999 : -x_node[i];
-    if(p.flags & PRE_ONE_PSI) nfft_precompute_one_psi(&p);
-  }
-  mad_cvec_copy(x, p.f, n);
-  const char *error_str = nfft_check(&p);
-  if (error_str) error("%s", error_str);
-  nfft_adjoint(&p); // nfft_adjoint_direct(&p);
-  mad_cvec_copy(p.f_hat+nr/2, r, nr/2); // for compatibility with FFTW
-  mad_cvec_copy(p.f_hat, r+nr/2, nr/2);
+  mad_nfft_exec(0, 1, n, nr, x_node, x, r);
 }
 
 void // frequency to time
 mad_cvec_infft (const cnum_t x[], const num_t r_node[], cnum_t r[], ssz_t n, ssz_t nx)
 {
-  assert( x && r );
-  int precomp = 0;
-  if (n != p_n || nx != p_m) {
-    nfft_finalize(&p);
-    nfft_init_1d (&p, n, nx);
-    p_n = n, p_m = nx, precomp = 1;
-  }
-  if (r_node || precomp) {
-    for (ssz_t i=0; i < n; i++) // forward transform needs -r_node
-      p.x[i] = r_node[i] == -0.5 ? 0.4999999999999999 : -r_node[i];
-    if(p.flags & PRE_ONE_PSI) nfft_precompute_one_psi(&p);
-  }
-  mad_cvec_copy(x+nx/2, p.f_hat, nx/2); // for compatibility with FFTW
-  mad_cvec_copy(x, p.f_hat+nx/2, nx/2);
-  const char *error_str = nfft_check(&p);
-  if (error_str) error("%s", error_str);
-  nfft_trafo(&p); // nfft_trafo_direct(&p);
-  mad_cvec_copy(p.f, r, n);
-  mad_cvec_muln(r, 1.0/n, r, n);
+  mad_nfft_exec(1, 1, n, nx, r_node, x, r);
 }
 
 // -- CLEANUP -----------------------------------------------------------------o
@@ -527,6 +1010,6 @@ mad_cvec_infft (const cnum_t x[], const num_t r_node[], cnum_t r[], ssz_t n, ssz
 void
 mad_vec_cleanup(void)
 {
-  nfft_finalize(&p);  memset(&p, 0, sizeof p);
-  fftw_cleanup();
+  mad_nfft_cleanup();
+  mad_fft_cleanup();
 }
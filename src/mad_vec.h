@@ -104,10 +104,29 @@ void   mad_cvec_nfft  (const cnum_t x[], const num_t x_node[]  , cnum_t  r[], ss
 void   mad_cvec_ifft  (const cnum_t x[],                         cnum_t  r[], ssz_t n); //  cvec ->cvec
 void   mad_cvec_irfft (const cnum_t x[],                          num_t  r[], ssz_t n); //  cvec -> vec
 void   mad_cvec_infft (const cnum_t x[], const num_t r_node[]  , cnum_t  r[], ssz_t n, ssz_t nx);
+int    mad_cvec_naff  (const cnum_t x[], num_t frq[], num_t amp[], num_t phs[], ssz_t n, ssz_t k); // cvec -> k freqs
 void   mad_cvec_center(const cnum_t x[],                         cnum_t  r[], ssz_t n); //  cvec ->cvec-<cvec>
 
 void   mad_vec_cleanup(void);
 
+// FFT plans cache (see mad_vec.c), rigor: 0=estimate, 1=measure, 2=patient, 3=exhaustive
+enum { mad_fft_fwd, mad_fft_bwd, mad_fft_r2c, mad_fft_c2r, mad_fft_rows=4 }; // kinds
+void   mad_fft_exec   (int kind, ssz_t m, ssz_t n, const void *x, void *r);
+int    mad_fft_rigor  (int rigor);                // -1 -> query, return previous
+int    mad_fft_wisdom (str_t fname, int save);     // load or save, return 1 on success
+void   mad_fft_cleanup(void);
+
+// NFFT plans (see mad_vec.c), m=1 for 1D
+typedef struct nfft nfft_t;
+nfft_t* mad_nfft_new    (ssz_t m, ssz_t n, ssz_t nr);
+void    mad_nfft_del    (nfft_t *p);
+void    mad_nfft_nodes  (nfft_t *p, const num_t x_node[]);
+void    mad_nfft_fwd    (nfft_t *p, const cnum_t x[], cnum_t r[]); // time to frequency
+void    mad_nfft_bwd    (nfft_t *p, const cnum_t x[], cnum_t r[]); // frequency to time
+void    mad_nfft_exec   (int bwd, ssz_t m, ssz_t n, ssz_t nr, const num_t node_[],
+                         const cnum_t x[], cnum_t r[]);            // cached plans
+void    mad_nfft_cleanup(void);
+
 // ----------------------------------------------------------------------------o
 
 #endif // MAD_VEC_H
\ No newline at end of file